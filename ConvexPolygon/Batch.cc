@@ -0,0 +1,90 @@
+#include "Batch.hh"
+#include "Parallel.hh"
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+using namespace std;
+
+/* Last command that writes a resource, and the commands that read it after that one. */
+struct ResourceState {
+	int writer;
+	vector<int> readers;
+
+	ResourceState() : writer(-1) {}
+};
+
+/* Builds the dependency graph: "successors[i]" are the commands that depend on "i", and "pending[i]" is the number of dependencies of "i"
+(a dependency may be counted more than once, as long as it also appears as many times in "successors"). */
+static void buildGraph(const vector<BatchAccess>& accesses, vector<vector<int>>& successors, vector<int>& pending) {
+	int size = accesses.size();
+	successors.assign(size, vector<int>());
+	pending.assign(size, 0);
+	unordered_map<string, ResourceState> resources;
+	int barrier = -1;                  // Last exclusive command.
+	vector<int> sinceBarrier;          // Commands after it.
+	auto depend = [&](int from, int to) {
+		if (from < 0 or from == to) return;
+		successors[from].push_back(to);
+		++pending[to];
+	};
+
+	for (int i = 0; i < size; ++i) {
+		const BatchAccess& access = accesses[i];
+		if (access.exclusive) {
+			for (int j : sinceBarrier) depend(j, i);
+			depend(barrier, i);
+			barrier = i;
+			sinceBarrier.clear();
+			resources.clear();
+			continue;
+		}
+		depend(barrier, i);
+		sinceBarrier.push_back(i);
+		for (const string& name : access.reads) {
+			ResourceState& state = resources[name];
+			depend(state.writer, i);
+			state.readers.push_back(i);
+		}
+		for (const string& name : access.writes) {
+			ResourceState& state = resources[name];
+			depend(state.writer, i);
+			for (int j : state.readers) depend(j, i);
+			state.writer = i;
+			state.readers.clear();
+		}
+	}
+}
+
+/* The commands without dependencies are submitted first. When a command finishes, the commands that depend on it are submitted from the same worker
+once all their dependencies are finished, so they go to the queue of that worker. Then, holding a lock, the command is marked as done and the worker
+finishes the commands that are done in order (so the calling thread only wakes up when all of them are finished). */
+void runBatch(const vector<BatchAccess>& accesses, int threads, const function<void(int)>& run, const function<void(int)>& finish) {
+	int size = accesses.size();
+	vector<vector<int>> successors;
+	vector<int> dependencies;
+	buildGraph(accesses, successors, dependencies);
+	unique_ptr<atomic<int>[]> pending(new atomic<int>[size]);
+	for (int i = 0; i < size; ++i) pending[i] = dependencies[i];
+
+	vector<char> done(size, false);
+	int nextToFinish = 0;
+	mutex finishLock;
+	condition_variable allFinished;
+	TaskPool pool(threads);
+	function<void(int)> start = [&](int i) {
+		pool.submit([&, i] {
+			run(i);
+			for (int j : successors[i]) if (--pending[j] == 0) start(j);
+			lock_guard<mutex> guard(finishLock);
+			done[i] = true;
+			while (nextToFinish < size and done[nextToFinish]) finish(nextToFinish++);
+			if (nextToFinish == size) allFinished.notify_one();
+		});
+	};
+	for (int i = 0; i < size; ++i) if (dependencies[i] == 0) start(i);
+
+	unique_lock<mutex> guard(finishLock);
+	allFinished.wait(guard, [&] { return nextToFinish == size; });
+}
@@ -0,0 +1,27 @@
+#ifndef Batch_hh
+#define Batch_hh
+#include <string>
+#include <vector>
+#include <functional>
+using namespace std;
+
+/* Parallel execution of a batch of commands that must give the same results as running them one after another.
+Every command declares the resources (polygon identifiers, file names...) that it reads and writes. A command depends on the previous ones
+that write a resource that it reads, and on the previous ones that read or write a resource that it writes; exclusive commands depend
+on all the previous ones, and all the following ones depend on them. The commands are run on a pool of workers with work stealing
+as soon as the commands they depend on are finished, and their results are handed back in the original order. */
+
+/** Resources used by a command. */
+struct BatchAccess {
+	vector<string> reads;
+	vector<string> writes;
+	bool exclusive;           // "true" if the command may use any resource.
+
+	BatchAccess() : exclusive(false) {}
+};
+
+/** Runs the commands described by "accesses" with "threads" workers. "run(i)" runs the command "i" in one of the workers,
+	and "finish(i)" is called once the command "i" and all the previous ones are finished. The calls to "finish" are made in order, one at a time. */
+void runBatch(const vector<BatchAccess>& accesses, int threads, const function<void(int)>& run, const function<void(int)>& finish);
+
+#endif
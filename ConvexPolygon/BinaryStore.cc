@@ -0,0 +1,159 @@
+#include "BinaryStore.hh"
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std;
+
+static const char magic[8] = {'C', 'V', 'X', 'P', 'O', 'L', 'Y', 0};
+static const uint32_t version = 1;
+static const int headerSize = 48;
+static const int entrySize = 24;
+
+/* The coordinates are borrowed from the mapping without conversion, so the format can only be used directly by little-endian machines. */
+static bool isLittleEndian() {
+	uint16_t one = 1;
+	unsigned char first;
+	memcpy(&first, &one, 1);
+	return first == 1;
+}
+
+/* Returns the given size rounded up to a multiple of 8. */
+static uint64_t align8(uint64_t size) {
+	return (size + 7)/8*8;
+}
+
+/* Writes "value" in "buffer" at the given position (little-endian, since the machine is). */
+template <typename T>
+static void put(vector<char>& buffer, uint64_t position, T value) {
+	memcpy(buffer.data() + position, &value, sizeof(T));
+}
+
+/* Reads a value of type T from "base" at the given position. */
+template <typename T>
+static T get(const char* base, uint64_t position) {
+	T value;
+	memcpy(&value, base + position, sizeof(T));
+	return value;
+}
+
+bool hasBinaryExtension(const string& nameFile) {
+	return nameFile.size() > binaryExtension.size() and nameFile.compare(nameFile.size() - binaryExtension.size(), binaryExtension.size(), binaryExtension) == 0;
+}
+
+bool isBinaryStore(const string& nameFile) {
+	ifstream in(nameFile, ios::binary);
+	char start[8];
+	return in.read(start, 8) and memcmp(start, magic, 8) == 0;
+}
+
+/* First, we compute the size of every section and fill the header, the name table and the index in a buffer.
+Then, the coordinates are written directly from the arrays of every polygon: first all the X coordinates, then all the Y coordinates.
+The polygons loaded from a binary file borrow the mapping of the file, which may be the one being saved, so the file is written
+with another name and then renamed: the mapping keeps the old file, and its polygons do not change. */
+bool saveBinary(const string& nameFile, const vector<string>& names, const vector<const ConvexPolygon*>& polygons) {
+	if (not isLittleEndian()) return false;
+	uint64_t namesSize = 0;
+	uint64_t totalVertices = 0;
+	for (size_t i = 0; i < names.size(); ++i) {
+		namesSize += names[i].size();
+		totalVertices += polygons[i]->getPoints().size();
+	}
+	uint64_t nameTableOffset = headerSize;
+	uint64_t indexOffset = align8(nameTableOffset + namesSize);
+	uint64_t coordinatesOffset = indexOffset + entrySize*names.size();
+
+	vector<char> buffer(coordinatesOffset, 0);
+	memcpy(buffer.data(), magic, 8);
+	put<uint32_t>(buffer, 8, version);
+	put<uint32_t>(buffer, 12, names.size());
+	put<uint64_t>(buffer, 16, nameTableOffset);
+	put<uint64_t>(buffer, 24, indexOffset);
+	put<uint64_t>(buffer, 32, coordinatesOffset);
+	put<uint64_t>(buffer, 40, totalVertices);
+
+	uint64_t nameOffset = 0;
+	uint64_t firstVertex = 0;
+	for (size_t i = 0; i < names.size(); ++i) {
+		memcpy(buffer.data() + nameTableOffset + nameOffset, names[i].data(), names[i].size());
+		uint64_t entry = indexOffset + entrySize*i;
+		int vertices = polygons[i]->getPoints().size();
+		put<uint64_t>(buffer, entry, nameOffset);
+		put<uint32_t>(buffer, entry + 8, names[i].size());
+		put<uint32_t>(buffer, entry + 12, vertices);
+		put<uint64_t>(buffer, entry + 16, firstVertex);
+		nameOffset += names[i].size();
+		firstVertex += vertices;
+	}
+
+	string temporary = nameFile + ".tmp";
+	ofstream out(temporary, ios::binary);
+	out.write(buffer.data(), buffer.size());
+	for (size_t i = 0; i < names.size(); ++i) {
+		const VertexArray& points = polygons[i]->getPoints();
+		out.write((const char*)points.xs(), sizeof(double)*points.size());
+	}
+	for (size_t i = 0; i < names.size(); ++i) {
+		const VertexArray& points = polygons[i]->getPoints();
+		out.write((const char*)points.ys(), sizeof(double)*points.size());
+	}
+	out.close();
+	if (not out or rename(temporary.c_str(), nameFile.c_str()) != 0) {
+		unlink(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+/* The file is mapped in memory, and the mapping is released when the last polygon that borrows its coordinates is destroyed.
+Every offset and size read from the file is checked against the size of the file before being used. */
+bool loadBinary(const string& nameFile, vector<pair<string, ConvexPolygon>>& loaded) {
+	if (not isLittleEndian()) return false;
+	int fd = open(nameFile.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat info;
+	if (fstat(fd, &info) != 0 or info.st_size < headerSize) {
+		close(fd);
+		return false;
+	}
+	uint64_t fileSize = info.st_size;
+	void* address = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (address == MAP_FAILED) return false;
+	shared_ptr<const void> mapping(address, [fileSize](const void* a) { munmap(const_cast<void*>(a), fileSize); });
+	const char* base = (const char*)address;
+
+	if (memcmp(base, magic, 8) != 0 or get<uint32_t>(base, 8) != version) return false;
+	uint64_t count = get<uint32_t>(base, 12);
+	uint64_t nameTableOffset = get<uint64_t>(base, 16);
+	uint64_t indexOffset = get<uint64_t>(base, 24);
+	uint64_t coordinatesOffset = get<uint64_t>(base, 32);
+	uint64_t totalVertices = get<uint64_t>(base, 40);
+	if (nameTableOffset < headerSize or indexOffset < nameTableOffset or coordinatesOffset % 8 != 0) return false;
+	if (indexOffset > fileSize or count > (fileSize - indexOffset)/entrySize or indexOffset + entrySize*count > coordinatesOffset) return false;
+	if (coordinatesOffset > fileSize or totalVertices > (fileSize - coordinatesOffset)/(2*sizeof(double))) return false;
+
+	const double* xs = (const double*)(base + coordinatesOffset);
+	const double* ys = xs + totalVertices;
+	vector<pair<string, ConvexPolygon>> polygons;
+	polygons.reserve(count);
+	for (uint64_t i = 0; i < count; ++i) {
+		uint64_t entry = indexOffset + entrySize*i;
+		uint64_t nameOffset = get<uint64_t>(base, entry);
+		uint64_t nameLength = get<uint32_t>(base, entry + 8);
+		uint64_t vertices = get<uint32_t>(base, entry + 12);
+		uint64_t firstVertex = get<uint64_t>(base, entry + 16);
+		if (nameOffset > indexOffset - nameTableOffset or nameLength > indexOffset - nameTableOffset - nameOffset) return false;
+		if (firstVertex > totalVertices or vertices > totalVertices - firstVertex) return false;
+		string name(base + nameTableOffset + nameOffset, nameLength);
+		VertexArray hull(xs + firstVertex, ys + firstVertex, vertices, mapping);
+		polygons.push_back({name, ConvexPolygon::fromHull(hull)});
+	}
+
+	loaded.insert(loaded.end(), polygons.begin(), polygons.end());
+	return true;
+}
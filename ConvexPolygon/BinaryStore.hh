@@ -0,0 +1,36 @@
+#ifndef BinaryStore_hh
+#define BinaryStore_hh
+#include <string>
+#include <vector>
+#include "ConvexPolygon.hh"
+using namespace std;
+
+/* Binary format to save and load sets of ConvexPolygons. All the numbers are little-endian, and every section starts at a multiple of 8 bytes:
+	- Header: the magic string "CVXPOLY" followed by a zero byte, the version (32 bits), the number of polygons (32 bits),
+	  and the offsets of the name table, the index and the coordinates, and the total number of vertices (64 bits each).
+	- Name table: the names of all the polygons, one after the other, without separators.
+	- Index: for every polygon, the offset of its name in the name table (64 bits), the length of its name (32 bits),
+	  its number of vertices (32 bits) and the position of its first vertex in the coordinate arrays (64 bits).
+	- Coordinates: the X coordinates of all the vertices, followed by the Y coordinates of all the vertices (64-bit doubles).
+The vertices of every polygon are stored as a convex hull, in the same order as the print command.
+When loading, the file is memory-mapped and the polygons borrow their coordinates directly from the mapping. */
+
+/** Files with this extension are saved in the binary format. */
+const string binaryExtension = ".cpb";
+
+/** Returns "true" if the name of the file ends with the extension of the binary format. */
+bool hasBinaryExtension(const string& nameFile);
+
+/** Returns "true" if the file exists and starts with the magic string of the binary format. */
+bool isBinaryStore(const string& nameFile);
+
+/** Saves the given polygons with the given names ("names[i]" is the name of "polygons[i]") in a binary file, overwriting it if it already existed
+	(the polygons loaded from the old file keep their coordinates).
+	Returns "false" if the file cannot be written. */
+bool saveBinary(const string& nameFile, const vector<string>& names, const vector<const ConvexPolygon*>& polygons);
+
+/** Loads the polygons stored in a binary file and appends them to "loaded", in the same order as in the file.
+	Returns "false" (and leaves "loaded" unchanged) if the file cannot be mapped or its contents are not valid. */
+bool loadBinary(const string& nameFile, vector<pair<string, ConvexPolygon>>& loaded);
+
+#endif
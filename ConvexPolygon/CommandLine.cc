@@ -0,0 +1,41 @@
+#include "CommandLine.hh"
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+using namespace std;
+
+LineReader::LineReader(int fd, function<void()> beforeRead) : fd(fd), beforeRead(beforeRead), buffer(1 << 16), start(0), filled(0), finished(false) {}
+
+/* We look for the end of the line in the part of the buffer that has not been returned yet. If there is none, the pending part is moved
+to the beginning of the buffer (which grows if the line does not fit) and more data is read. As "getline" does, the last line is returned
+even without an end of line character, but there is no empty line after the last end of line character. */
+bool LineReader::next(const char*& begin, const char*& end) {
+	size_t scanned = start;
+	while (true) {
+		const char* newline = (const char*)memchr(buffer.data() + scanned, '\n', filled - scanned);
+		if (newline != nullptr) {
+			begin = buffer.data() + start;
+			end = newline;
+			start = newline - buffer.data() + 1;
+			return true;
+		}
+		if (finished) {
+			if (start == filled) return false;
+			begin = buffer.data() + start;
+			end = buffer.data() + filled;
+			start = filled;
+			return true;
+		}
+
+		memmove(buffer.data(), buffer.data() + start, filled - start);
+		filled -= start;
+		start = 0;
+		scanned = filled;
+		if (filled == buffer.size()) buffer.resize(2*buffer.size());
+		if (beforeRead) beforeRead();
+		ssize_t bytes = read(fd, buffer.data() + filled, buffer.size() - filled);
+		if (bytes < 0 and errno == EINTR) continue;
+		if (bytes <= 0) finished = true;
+		else filled += bytes;
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef CommandLine_hh
+#define CommandLine_hh
+#include <string>
+#include <vector>
+#include <functional>
+#include "FastParse.hh"
+using namespace std;
+
+/* The CommandLine class reads the words and numbers of a line of the calculator, held in memory, without copying the line.
+It is used like an input stream: the extraction operators skip the white space, and once an extraction fails, the following ones fail too. */
+
+class CommandLine {
+
+public:
+	/** Constructor. The characters in [begin, end) must stay valid while the CommandLine is used. */
+	CommandLine(const char* begin, const char* end) : p(begin), end(end), failed(false) {}
+
+	/** Reads the next word into "word". If there are no more words, "word" does not change and the CommandLine fails. */
+	CommandLine& operator>> (string& word) {
+		const char* start;
+		size_t size;
+		if (not failed) parseWord(p, end, start, size);
+		if (failed or size == 0) failed = true;
+		else word.assign(start, size);
+		return *this;
+	}
+
+	/** Reads the next number into "value". If there is no number at this point of the line, "value" becomes 0 and the CommandLine fails. */
+	CommandLine& operator>> (double& value) {
+		if (failed or not parseDouble(p, end, value)) {
+			value = 0;
+			failed = true;
+		}
+		return *this;
+	}
+
+	/** Returns "true" if no extraction has failed. */
+	explicit operator bool() const { return not failed; }
+
+private:
+
+	/** Current position, end of the line and state. */
+	const char* p;
+	const char* end;
+	bool failed;
+};
+
+/* The LineReader class reads the lines of a file descriptor through a buffer that is reused for the whole input.
+It reads the data as soon as it is available, so it also works with interactive input. Before reading, which may block until the next line
+is written, it calls a given function (for instance, to write the pending responses). */
+
+class LineReader {
+
+public:
+	/** Constructor. If given, "beforeRead" is called every time that more data has to be read from the file descriptor. */
+	explicit LineReader(int fd, function<void()> beforeRead = nullptr);
+
+	/** Stores in [begin, end) the next line, without its end of line character. Returns "false" if there are no more lines.
+		The line is valid until the next call. */
+	bool next(const char*& begin, const char*& end);
+
+private:
+
+	/** File descriptor, buffer, and part of the buffer [start, filled) that has not been returned yet. */
+	int fd;
+	function<void()> beforeRead;
+	vector<char> buffer;
+	size_t start, filled;
+	bool finished;
+};
+
+#endif
@@ -1,22 +1,96 @@
 #include "Point.hh"
 #include "ConvexPolygon.hh"
+#include "Parallel.hh"
+#include "Kernels.hh"
+#include "Stats.hh"
+#include "Raster.hh"
 #include <vector>
 #include <string>
 #include <map>
 #include <algorithm>
 #include <cmath>
+#include <limits>
+#include <array>
+#include <atomic>
 #include <pngwriter.h>
 #include <sstream>
 #include <iostream>
 using namespace std;
 
+/* Statistics of the main operations (see Stats.hh). The union of a list of polygons is measured through the unions of pairs that it makes. */
+static Metric& hullMetric = metric("ConvexPolygon::convexHull");
+static Metric& prefilterMetric = metric("ConvexPolygon::prefilter");
+static Metric& intersectionMetric = metric("ConvexPolygon::getIntersection");
+static Metric& unionMetric = metric("ConvexPolygon::getUnion");
+static Metric& insideMetric = metric("ConvexPolygon::inside");
+static Metric& drawMetric = metric("ConvexPolygon::drawPolygon");
+
+/* Buffers of the construction of a hull. Every thread has its own ones, which keep their memory from one call to the next,
+so that building the hull of a few points does not allocate memory once the buffers have grown. */
+struct HullScratch {
+	vector<Point> upper, lower;     // Chains of the hull.
+	vector<Point> hull;             // Vertices of the hull, before they are copied to a ConvexPolygon.
+	vector<Point> points;           // Points whose hull is built, when they are not given by the caller.
+	vector<Point> sorted, merged;   // Vertices of a polygon sorted by X coordinate, and merged with the points added to it.
+};
+
+static HullScratch& hullScratch() {
+	static thread_local HullScratch scratch;
+	return scratch;
+}
+
 /* Implementation of the ConvexPolygon class */
-ConvexPolygon::ConvexPolygon(vector<Point> v) {
-	_points = convexHull(v);  	
+ConvexPolygon::ConvexPolygon(vector<Point> v, HullEngine engine) : _cached(false) {
+	vector<Point>& hull = hullScratch().hull;
+	convexHull(v, hull, engine);
+	setVertices(hull);
 }
 
 /* Implementation of the class ConvexPolygon */
-ConvexPolygon::ConvexPolygon() {}
+ConvexPolygon::ConvexPolygon() : _cached(false) {}
+
+/* The hull is built in the buffer of the thread, and the given points are sorted in place instead of being copied. */
+ConvexPolygon ConvexPolygon::fromPoints(vector<Point>& points, HullEngine engine) {
+	ConvexPolygon polygon;
+	vector<Point>& hull = hullScratch().hull;
+	polygon.convexHull(points, hull, engine);
+	polygon.setVertices(hull);
+	return polygon;
+}
+
+/* The vertices are shared with "hull" unless they are stored inside it. */
+ConvexPolygon ConvexPolygon::fromHull(const VertexArray& hull) {
+	ConvexPolygon polygon;
+	polygon._points = hull;
+	return polygon;
+}
+
+/* Only the storage changes, so the cached properties remain valid. */
+void ConvexPolygon::setStorage(const VertexArray& points) {
+	_points = points;
+}
+
+/* Any change of the vertices goes through here, so the cache never keeps properties of old vertices. 
+The vertices are copied into the memory that the VertexArray already has, so small polygons do not allocate memory. */
+void ConvexPolygon::setVertices(const vector<Point>& points) {
+	_points.assign(points.data(), points.size());
+	_cached = false;
+}
+
+/* The area, the perimeter, the centroid and the bounds are calculated together by a vectorized kernel, which walks the arrays of coordinates only once. */
+void ConvexPolygon::computeProperties() const {
+	if (_cached) return;
+	PolygonSums sums;
+	polygonSums(_points.xs(), _points.ys(), _points.size(), sums);
+	_area = abs(sums.area/2);
+	_perimeter = sums.perimeter;
+	_centroid = {sums.cX/(_area*6), sums.cY/(_area*6)};
+	_xmin = sums.xmin;
+	_xmax = sums.xmax;
+	_ymin = sums.ymin;
+	_ymax = sums.ymax;
+	_cached = true;
+}
 
 /* Pre: the given vector must not be empty.
 Invariant: the point "minPoint" stores the point in [0 ... i] with the lowest X coordinate. In case of a tie, stores the one with the lowest Y coordinate. 
@@ -83,23 +157,102 @@ int ConvexPolygon::orientation(Point p1, Point p2, Point p3) const {
 	return (orientation > 0) ? 1 : 2;     /** The points are clockwise or counter-clockwise */
 }
 
-/* Given a vector of points, it sorts them in the correct order with the call of the function "sortPoints" and returns a vector that will contain just the points that are the vertices of a ConvexPolygon. We make a distinction between three cases:
-- If the size of the sorted vector is = "1", we return it. (The ConvexPolygon is a point).  
-- If the size of the sorted vector is = "2", we check if its two points are the same. In this case, we remove the last one. (The ConvexPolygon is a segment).
-- If the size of the sorted vector is >= "3", we create a new vector named "finalPolygon", initialized with the first two vertices of the sorted vector.  
+/* Whether "convexHull" discards the points inside the polygon of extreme points first. */
+static atomic<bool> prefilterEnabled(true);
+
+void setHullPrefilter(bool enabled) {
+	prefilterEnabled = enabled;
+}
+
+bool hullPrefilter() {
+	return prefilterEnabled.load(memory_order_relaxed);
+}
+
+/* Inputs smaller than this are not filtered: the sort of a few points is cheaper than looking for the extreme points. */
+static const int prefilterThreshold = 64;
+
+/* The extremes are read from the coordinates of the points, which are stored one point after another. */
+static_assert(sizeof(Point) == 2*sizeof(double), "the coordinates of the points must be contiguous");
+
+/* Akl-Toussaint heuristic: the points that go farthest in eight directions are vertices of the hull (or lie on its boundary), so every point 
+strictly inside the polygon that they form (an octagon, with less sides when some of them are the same point) is strictly inside the hull, and 
+can be discarded before sorting. The extremes are found by a vectorized kernel in a single pass. A point is only discarded when it is on the 
+inner side of every side of the octagon by more than the rounding error of the cross product, so the points that are almost on a side, which 
+may be on the boundary of the hull, are always kept and the hull does not change. The order of the points that are kept does not change either.
+Returns the number of discarded points. */
+static int discardInteriorPoints(vector<Point>& points) {
+	int size = points.size();
+	ExtremePoints extremes;
+	extremePoints(reinterpret_cast<const double*>(points.data()), size, extremes);
+	Point corners[8];
+	int sides = 0;
+	for (int k = 0; k < 8; ++k) {
+		const Point& p = points[extremes.position[k]];
+		if (sides == 0 or p != corners[sides-1]) corners[sides++] = p;
+	}
+	while (sides > 1 and corners[sides-1] == corners[0]) --sides;
+	if (sides < 3) return 0;
+
+	double ax[8], ay[8], dx[8], dy[8];
+	for (int k = 0; k < sides; ++k) {
+		const Point& next = corners[(k + 1)%sides];
+		ax[k] = corners[k].get_x();
+		ay[k] = corners[k].get_y();
+		dx[k] = next.get_x() - ax[k];
+		dy[k] = next.get_y() - ay[k];
+	}
+	const double tolerance = 1e-12;
+	int kept = 0;
+	for (int i = 0; i < size; ++i) {
+		double x = points[i].get_x(), y = points[i].get_y();
+		bool inside = true;
+		for (int k = 0; k < sides and inside; ++k) {
+			double u = dx[k]*(y - ay[k]), v = dy[k]*(x - ax[k]);
+			inside = u - v > tolerance*(abs(u) + abs(v));
+		}
+		if (not inside) points[kept++] = points[i];
+	}
+	points.resize(kept);
+	return size - kept;
+}
+
+vector<Point> ConvexPolygon::convexHull(vector<Point>& points, HullEngine engine) {
+	vector<Point> hull;
+	convexHull(points, hull, engine);
+	return hull;
+}
+
+/* Both engines return the vertices clockwise, starting from the point with the lowest X coordinate (and lowest Y in case of a tie). 
+Big inputs of the monotone chain go through the prefilter first (the slope-based scan does not always ignore the points inside the hull, 
+so it is kept as it was). */
+void ConvexPolygon::convexHull(vector<Point>& points, vector<Point>& hull, HullEngine engine) {
+	Timer timer(hullMetric, points.size());
+	if (engine == MonotoneChain and hullPrefilter() and points.size() >= prefilterThreshold) {
+		Timer prefilterTimer(prefilterMetric, points.size());
+		int discarded = discardInteriorPoints(points);
+		if (prefilterTimer.active()) prefilterMetric.discarded.record(discarded);
+	}
+	if (engine == GrahamScan) grahamScan(points, hull);
+	else monotoneChain(points, hull);
+}
+
+/* Given a vector of points, it sorts them in the correct order with the call of the function "sortPoints" and stores in "finalPolygon" just the points that are the vertices of a ConvexPolygon. We make a distinction between three cases:
+- If the size of the sorted vector is = "1", we store its point. (The ConvexPolygon is a point).  
+- If the size of the sorted vector is = "2", we check if its two points are the same. In this case, we only store one of them. (Otherwise, the ConvexPolygon is a segment).
+- If the size of the sorted vector is >= "3", we initialize "finalPolygon" with the first two vertices of the sorted vector.  
 Afterward, we compare the points of the sorted vector one by one with the last two points of the vector "finalPolygon".
 - If they are counter-clockwise, we push the point to the "finalPolygon".
 - Otherwise, we remove the last points of the "finalPolygon" (it formed a >180 degrees inside angle or it was collinear with the other two points.
 Then, we push the point and check whether the three last points of the "finalPolygon" are collinear. */
-vector<Point> ConvexPolygon::convexHull(vector<Point>& points) {
+void ConvexPolygon::grahamScan(vector<Point>& points, vector<Point>& finalPolygon) {
+    finalPolygon.clear();
+    if (points.empty()) return;
     sortPoints(points);
-    if (points.size() == 1) return points;
-    else if (points.size() == 2 and points[0] == points[1]) {
-    	points.pop_back(); 
-    	return points;
-    } 
+    if (points.size() == 1) finalPolygon.push_back(points[0]);
+    else if (points.size() == 2 and points[0] == points[1]) finalPolygon.push_back(points[0]);
     else {
-		vector<Point> finalPolygon = {points[0], points[1]};
+		finalPolygon.push_back(points[0]);
+		finalPolygon.push_back(points[1]);
 		int size = 2;  
 		for (int i = 2; i < points.size(); ++i) {
 			 if (orientation(finalPolygon[size-2], finalPolygon[size-1], points[i]) == 2) {
@@ -117,11 +270,226 @@ vector<Point> ConvexPolygon::convexHull(vector<Point>& points) {
 				}		
 			}
 		} 
+	}
+}
+
+/* Inputs smaller than this are handled by a single thread: below it, starting the threads costs more than the work they save. */
+static const int parallelHullThreshold = 1 << 16;
+
+/* Given two points, it returns "true" if "p1" goes before "p2" when sorting by X coordinate and, in case of a tie, by Y coordinate. */
+static bool lowerXY(const Point& p1, const Point& p2) {
+	return p1.get_x() < p2.get_x() or (p1.get_x() == p2.get_x() and p1.get_y() < p2.get_y());
+}
+
+/* Given three points, it returns the cross product of the vectors 'p0p1' and 'p0p2'. It is positive if they make a left turn, 
+negative if they make a right turn and "0" if they are collinear. */
+static double cross(const Point& p0, const Point& p1, const Point& p2) {
+	return (p1.get_x() - p0.get_x())*(p2.get_y() - p0.get_y()) - (p1.get_y() - p0.get_y())*(p2.get_x() - p0.get_x());
+}
 
-		return finalPolygon;
+/* Given the points in [first, last), sorted by X coordinate, it extends "chain" with them so that it becomes the upper chain of the convex hull
+of its previous points and the new ones when "upper" is "true", or the lower chain otherwise. Both chains go from left to right, and a point is 
+removed from the chain while it does not make a strict turn to the correct side (right for the upper chain, left for the lower one), 
+so collinear points are discarded. */
+static void buildChain(const Point* first, const Point* last, bool upper, vector<Point>& chain) {
+	for (const Point* p = first; p != last; ++p) {
+		while (chain.size() >= 2) {
+			double turn = cross(chain[chain.size()-2], chain[chain.size()-1], *p);
+			if (upper ? turn < 0 : turn > 0) break;
+			chain.pop_back();
+		}
+		chain.push_back(*p);
 	}
 }
 
+/* The sorted vector is split in contiguous slabs, one per task (with a single task, the chains are built directly in the buffers of the thread), and each thread builds the upper and lower chains of its own slab. 
+Any point that is not in the chain of its slab cannot be in the chain of the whole set, so the final chains are obtained by running
+the same construction over the concatenation of the chains of the slabs, which are already sorted.
+Finally, the upper chain (from left to right) and the lower chain (from right to left) are joined, which gives the vertices in clockwise order
+starting from the point with the lowest X coordinate. 
+Pre: the points are sorted by X coordinate (and Y in case of a tie), without repetitions. */
+static void hullOfSortedPoints(const vector<Point>& points, int tasks, vector<Point>& finalPolygon) {
+	int size = points.size();
+	finalPolygon.clear();
+	if (size <= 2) {
+		finalPolygon.insert(finalPolygon.end(), points.begin(), points.end());
+		return;
+	}
+
+	HullScratch& scratch = hullScratch();
+	vector<Point>& upper = scratch.upper;
+	vector<Point>& lower = scratch.lower;
+	upper.clear();
+	lower.clear();
+	tasks = max(1, min(tasks, size/3));
+	if (tasks == 1) {
+		buildChain(points.data(), points.data() + size, true, upper);
+		buildChain(points.data(), points.data() + size, false, lower);
+	} else {
+		vector<vector<Point>> upperChains(tasks), lowerChains(tasks);
+		parallelFor(tasks, [&](int t) {
+			const Point* first = points.data() + (long)size*t/tasks;
+			const Point* last = points.data() + (long)size*(t+1)/tasks;
+			buildChain(first, last, true, upperChains[t]);
+			buildChain(first, last, false, lowerChains[t]);
+		});
+		for (int t = 0; t < tasks; ++t) {
+			buildChain(upperChains[t].data(), upperChains[t].data() + upperChains[t].size(), true, upper);
+			buildChain(lowerChains[t].data(), lowerChains[t].data() + lowerChains[t].size(), false, lower);
+		}
+	}
+
+	finalPolygon.insert(finalPolygon.end(), upper.begin(), upper.end());
+	for (int i = lower.size() - 2; i > 0; --i) finalPolygon.push_back(lower[i]);
+}
+
+/* First, the points are sorted by X coordinate (and Y in case of a tie) and the repeated ones are removed. Then, the chains are built. */
+void ConvexPolygon::monotoneChain(vector<Point>& points, vector<Point>& hull) const {
+	int tasks = (points.size() >= parallelHullThreshold) ? hardwareThreads() : 1;
+	parallelSort(points.begin(), points.end(), lowerXY, tasks);
+	points.erase(unique(points.begin(), points.end()), points.end());
+	hullOfSortedPoints(points, tasks, hull);
+}
+
+/* Given the vertices of a ConvexPolygon (clockwise, starting from the point with the lowest X coordinate), it stores them in "sorted" sorted by X coordinate 
+(and Y in case of a tie) in linear time, using "upper" and "lower" as buffers. The vertices from the first one to the one with the biggest X coordinate (the upper path), and the
+vertices from the last one back to that one (the lower path), are both already sorted, so we only have to merge the two paths. */
+static void sortedVertices(const VertexArray& hull, vector<Point>& sorted, vector<Point>& upper, vector<Point>& lower) {
+	int size = hull.size();
+	sorted.clear();
+	if (size <= 1) {
+		if (size == 1) sorted.push_back(hull[0]);
+		return;
+	}
+	int right = 0;
+	for (int i = 1; i < size; ++i) if (lowerXY(hull[right], hull[i])) right = i;
+
+	upper.clear();
+	lower.clear();
+	for (int i = 1; i <= right; ++i) upper.push_back(hull[i]);
+	for (int i = size - 1; i > right; --i) lower.push_back(hull[i]);
+	sorted.resize(size);
+	sorted[0] = hull[0];
+	merge(upper.begin(), upper.end(), lower.begin(), lower.end(), sorted.begin() + 1, lowerXY);
+}
+
+/* Given the vertices of a ConvexPolygon with at least three vertices (clockwise, starting from the point with the lowest X coordinate) and a point "p" 
+outside it, it replaces the vertices that "p" hides by "p". The edges that "p" sees (it lies on their left side, or on their line) are contiguous, 
+and the vertices between them are the hidden ones. An edge that "p" sees and one that it does not see are found with a binary search over the rays 
+from the first vertex, as in "pointPosition", and then two binary searches between them find the first and the last edges that "p" sees, so the 
+tangents take O(log n) time. Finally, the hidden vertices are replaced by "p" with a single move of the coordinate arrays. When "p" becomes the 
+first vertex, the vertices that are kept are still contiguous, except the old first one when it goes right before "p" (at the end). */
+static void addOutsidePoint(VertexArray& hull, const Point& p) {
+	int n = hull.size();
+	auto sees = [&](int i) { return cross(hull[i], hull[(i+1)%n], p) >= 0; };
+	const Point p0 = hull[0];
+	double first = cross(p0, hull[1], p);
+	double last = cross(p0, hull[n-1], p);
+
+	int seen, hidden;
+	if (first >= 0) seen = 0;
+	else if (last <= 0) seen = n - 1;
+	else {
+		int lo = 1, hi = n - 1;
+		while (hi - lo > 1) {
+			int mid = (lo + hi)/2;
+			if (cross(p0, hull[mid], p) <= 0) lo = mid;
+			else hi = mid;
+		}
+		seen = lo;
+	}
+	/* When "p" is behind the first vertex, the line from "p" through it leaves the polygon through an edge that "p" does not see. */
+	if (first < 0) hidden = 0;
+	else if (last > 0) hidden = n - 1;
+	else {
+		int lo = 1, hi = n - 1;
+		while (hi - lo > 1) {
+			int mid = (lo + hi)/2;
+			if (cross(p0, hull[mid], p) >= 0) lo = mid;
+			else hi = mid;
+		}
+		hidden = lo;
+	}
+
+	int lo = 0, hi = (hidden - seen + n)%n;
+	while (hi - lo > 1) {
+		int mid = (lo + hi)/2;
+		if (sees((seen + mid)%n)) lo = mid;
+		else hi = mid;
+	}
+	int b = (seen + lo)%n;
+	lo = 0;
+	hi = (seen - hidden + n)%n;
+	while (hi - lo > 1) {
+		int mid = (lo + hi)/2;
+		if (sees((hidden + mid)%n)) hi = mid;
+		else lo = mid;
+	}
+	int a = (hidden + hi)%n;
+
+	/* The edges [a, b] are seen, so the vertices a+1 ... b are hidden. */
+	if (b < a) {                               // The first vertex is hidden, and "p" is the new one.
+		hull.splice(0, b + 1, p);
+		hull.truncate(a - b + 1);
+	}
+	else if (not lowerXY(p, p0)) hull.splice(a + 1, b + 1, p);
+	else if (b == n - 1) {                     // "p" goes before the first vertex.
+		hull.splice(0, 0, p);
+		hull.truncate(a + 2);
+	}
+	else {                                     // "p" goes after the first vertex, which becomes the last one.
+		hull.splice(0, b + 1, p);
+		hull.push_back(p0);
+	}
+}
+
+bool ConvexPolygon::addPoint(const Point& p) {
+	return addPoints(&p, &p + 1);
+}
+
+bool ConvexPolygon::addPoints(const vector<Point>& points) {
+	return addPoints(points.data(), points.data() + points.size());
+}
+
+/* Up to this number of points outside the ConvexPolygon, they are added one by one; with more of them, the hull is built again. */
+static const int extendRebuildThreshold = 32;
+
+/* The points are located with "pointPosition", so the points inside the ConvexPolygon or on its boundary cost O(log n) time and do not copy anything. 
+A few points outside are added one by one with "addOutsidePoint" (a point that an earlier one has hidden is located again and discarded). 
+Many points outside are sorted instead, and merged with the vertices, which are obtained sorted in linear time, so that the new hull is built 
+like the union of two polygons in O(n + k log k) time. Points and segments are small, so they are always built again. 
+A point outside the ConvexPolygon always changes its vertices. */
+bool ConvexPolygon::addPoints(const Point* first, const Point* last) {
+	HullScratch& scratch = hullScratch();
+	vector<Point>& outside = scratch.points;
+	outside.clear();
+	for (const Point* p = first; p != last; ++p) {
+		if (pointPosition(*p) == Outside) outside.push_back(*p);
+	}
+	if (outside.empty()) return false;
+
+	int count = outside.size();
+	if (count <= extendRebuildThreshold and _points.size() >= 3) {
+		for (int i = 0; i < count; ++i) {
+			if (i == 0 or pointPosition(outside[i]) == Outside) addOutsidePoint(_points, outside[i]);
+		}
+		_cached = false;
+		return true;
+	}
+
+	sort(outside.begin(), outside.end(), lowerXY);
+	outside.erase(unique(outside.begin(), outside.end()), outside.end());
+
+	vector<Point>& sorted = scratch.sorted;
+	vector<Point>& merged = scratch.merged;
+	sortedVertices(_points, sorted, scratch.upper, scratch.lower);
+	merged.resize(sorted.size() + outside.size());
+	merge(sorted.begin(), sorted.end(), outside.begin(), outside.end(), merged.begin(), lowerXY);
+	hullOfSortedPoints(merged, 1, scratch.hull);
+	setVertices(scratch.hull);
+	return true;
+}
+
 void ConvexPolygon::printVertices() const {
 	for (int i = 0; i < _points.size(); ++i) { 
 		cout << " ";
@@ -130,29 +498,16 @@ void ConvexPolygon::printVertices() const {
 	cout << endl;
 }
 
+/* The area is cached together with the other derived properties. */
 double ConvexPolygon::getArea() const {
-	double area = 0;
-	int j = _points.size() - 1;    	 // This index allows counting the first vertice twice.
-	for (int i = 0; i < _points.size(); ++i) {
-		area += ((_points[j].get_x() + _points[i].get_x()) * (_points[j].get_y() - _points[i].get_y()));
-		j = i;
-	}
-
-	return abs(area/2);
+	computeProperties();
+	return _area;
 }
 
 /* Adds all distances up, from one vertice to the next one, from first to last. */
 double ConvexPolygon::getPerimeter() const {
-	double perimeter = 0;
-	int j = _points.size() - 1;   // This index allows counting the first vertice twice.
-	for (int i = 0; i < _points.size(); ++i) {
-		double dx = _points[j].get_x() - _points[i].get_x();
-		double dy = _points[j].get_y() - _points[i].get_y();
-		perimeter += sqrt(dx*dx + dy*dy);
-		j = i;
-	} 
-
-	return perimeter;
+	computeProperties();
+	return _perimeter;
 }
 
 /* The number of vertices of a ConvexPolygon is equal to the size of its vector of points that defines the polygon. */
@@ -168,19 +523,20 @@ double ConvexPolygon::getEdges() const {
 /* The X coordinate of the baricenter of a ConvexPolygon can be calculated as 1/6 of the area * the sumatorium, from i = 0,...,i = n - 1,
 of (X_i + X_i+1)*(X_i*Y_i+1 - X_i+1*Y_i). The same with the Y coordinate but replacing the first two X for two Y. */
 Point ConvexPolygon::getCentroid() const {
-	double cX = 0;
-	double cY = 0;
+	computeProperties();
+	return _centroid;
+}
 
-	int j = _points.size() - 1;   // This index allows us to count the first vertice twice.
-	for (int i = 0; i < _points.size(); ++i) {
-		cX += (_points[i].get_x() + _points[j].get_x()) * (_points[i].get_x()*_points[j].get_y() - _points[j].get_x()*_points[i].get_y());
-		cY += (_points[i].get_y() + _points[j].get_y()) * (_points[i].get_x()*_points[j].get_y() - _points[j].get_x()*_points[i].get_y());
-		j = i;
-	} 
-	cX /= (getArea()*6);
-	cY /= (getArea()*6);
+const VertexArray& ConvexPolygon::getPoints() const {
+	return _points;
+}
 
-	return {cX, cY};
+void ConvexPolygon::getBounds(double& xmin, double& xmax, double& ymin, double& ymax) const {
+	computeProperties();
+	xmin = _xmin;
+	xmax = _xmax;
+	ymin = _ymin;
+	ymax = _ymax;
 }
 
 /* If the X coordinate of a given point p is bigger than the given "xmax" passed by reference, xmax = X coordinate of p.
@@ -192,39 +548,51 @@ void ConvexPolygon::lowestAndBiggest(double& xmax, double& xmin, double& ymax, d
 	ymin = min(ymin, p.get_y());
 }
 
-/* First, we calculate the maximum and minimum X and Y coordinates of the first point of the first given ConvexPolyon.
-Then, we compare these values with all the points of all the ConvexPolygons in the map whose name is stored in the given vector "insiders", 
-and store the maximum and minimum X and Y coordinates in "xmax", "xmin", "ymax" and "ymin". 
+/* First, we take the bounds of the first given ConvexPolygon that is not empty (if all of them are empty, so is the bounding box). Then, we compare 
+these values with the (cached) bounds of the rest of non-empty ConvexPolygons in the given vector, and store the maximum and minimum X and Y coordinates 
+in "xmax", "xmin", "ymax" and "ymin". 
 Finally, we return the ConvexPolygon that has for vertices the points: (xmin, ymin), (xmax, ymin), (xmax, ymax), and (xmin, ymax). */
-ConvexPolygon ConvexPolygon::boundingBox(map<string, ConvexPolygon>& polygons, const vector<string>& insiders) const {
-	double xmax, xmin, ymax, ymin;
-	xmax = xmin = polygons[insiders[0]]._points[0].get_x();
-	ymax = ymin = polygons[insiders[0]]._points[0].get_y();
+ConvexPolygon ConvexPolygon::boundingBox(const vector<const ConvexPolygon*>& polygons) const {
+	int size = polygons.size();
+	int first = 0;
+	while (first < size and polygons[first]->_points.empty()) ++first;
+	if (first == size) return ConvexPolygon();
 
-	for (int i = 0; i < insiders.size(); ++i) {
-		string name = insiders[i];		
- 		for (int j = 0; j < polygons[name]._points.size(); ++j) {
-			lowestAndBiggest(xmax, xmin, ymax, ymin, polygons[name]._points[j]);
-		}
+	double xmax, xmin, ymax, ymin;
+	polygons[first]->getBounds(xmin, xmax, ymin, ymax);
+	for (int i = first + 1; i < size; ++i) {
+		const ConvexPolygon& polygon = *polygons[i];
+		if (polygon._points.empty()) continue;
+		double pxmin, pxmax, pymin, pymax;
+		polygon.getBounds(pxmin, pxmax, pymin, pymax);
+		lowestAndBiggest(xmax, xmin, ymax, ymin, {pxmin, pymin});
+		lowestAndBiggest(xmax, xmin, ymax, ymin, {pxmax, pymax});
 	} 
-	ConvexPolygon squarePolygon({{xmin, ymin}, {xmax, ymin}, {xmax, ymax}, {xmin, ymax}});
+	vector<Point>& corners = hullScratch().points;
+	corners.assign({{xmin, ymin}, {xmax, ymin}, {xmax, ymax}, {xmin, ymax}});
 	
-	return squarePolygon;
+	return fromPoints(corners);
 }
 
-/* If the X coordinate of the given point "p" is bigger than its Y coordinate, it means that the boundingBox that contains all ConvexPolygons is a 
-rectangle with a larger base rather than height. We must zoom in so that the large of the base becomes 498. 
-Otherwise, we must zoom in so that the large of the height becomes 498. */
-double ConvexPolygon::getScaleFactor(Point p, Point& translator) const {
+/* If the base of the given point "p" (the size of the boundingBox that contains all ConvexPolygons) is larger than its height relative to the rectangle,
+we must zoom in so that the base becomes width - 2. Otherwise, we must zoom in so that the height becomes height - 2.
+A boundingBox that is a single point is not scaled, and it goes to the center. */
+double ConvexPolygon::getScaleFactor(Point p, Point& translator, int width, int height) const {
+	if (p.get_x() == 0 and p.get_y() == 0) {
+		translator = {width/2.0, height/2.0};
+		return 1;
+	}
 	double scaleFactor;
+	double scaleX = (width - 2)/p.get_x();
+	double scaleY = (height - 2)/p.get_y();
 	
-	if (p.get_x() >= p.get_y()) {
-		scaleFactor = 498 / p.get_x();
-		double y = (498 - p.get_y()*scaleFactor)/2 + 1;
+	if (scaleX <= scaleY) {
+		scaleFactor = scaleX;
+		double y = (height - 2 - p.get_y()*scaleFactor)/2 + 1;
 		translator = {1, y};
 	} else {
-		scaleFactor = 498 / p.get_y();
-		double x = (498 - p.get_x()*scaleFactor)/2 + 1;
+		scaleFactor = scaleY;
+		double x = (width - 2 - p.get_x()*scaleFactor)/2 + 1;
 		translator = {x, 1};
 	}
 
@@ -234,7 +602,7 @@ double ConvexPolygon::getScaleFactor(Point p, Point& translator) const {
 /* We modify the X coordinate of the given point "p" by adding the corresponding value stored in "dx" to its X coordinate.
 Then, we multiply it by the given "scaleFactor" and finally, we add the X coordinate of the given points "translator".
 The same with the Y coordinate. */
-Point ConvexPolygon::scaleAndTranslate(Point& p, double dx, double dy, double scaleFactor, Point& translator) const {
+Point ConvexPolygon::scaleAndTranslate(const Point& p, double dx, double dy, double scaleFactor, Point& translator) const {
 	double x = (p.get_x() + dx)*scaleFactor + translator.get_x();
 	double y = (p.get_y() + dy)*scaleFactor + translator.get_y();
 	Point q = {x, y};
@@ -243,35 +611,60 @@ Point ConvexPolygon::scaleAndTranslate(Point& p, double dx, double dy, double sc
 } 
 
 /* The procedure used to scale and translate the set of ConvexPolygons is the following:
-First, we calculate the distance between the lowest and most left points of the given boundingBox that contains all the ConvexPolygons to the point (0,0). 
+First, we calculate the distance between the lowest and most left points of the given boundingBox that contains all the ConvexPolygons to the point (0,0),
+taking them from its bounds, since the boundingBox of points or segments has less than four vertices. 
 From the reference values above, we translate all the vertices of the ConvexPolygons, so that the lowest and most left point of the new boundingBox containing them
 would be the point (0,0).
-Next, we zoom in or zoom out so that the ConvexPolygons fit perfectly in the 498x498 square, and finally translate again so that they are centered in the middle of the image. */
-void ConvexPolygon::drawPolygon(map<string, ConvexPolygon>& polygons, map<string, vector<double>>& colors, vector<string> insiders, ConvexPolygon& boundingBox, string nameFile) const {
-	double dx = 0 - boundingBox._points[0].get_x();
-	double dy = 0 - boundingBox._points[0].get_y();
+Next, we zoom in or zoom out so that the ConvexPolygons fit perfectly in the image without its outer pixels, and finally translate again so that they are centered
+in the middle of the image (in the coordinates of the Raster, whose first pixel is at 0 instead of 1).
+The ConvexPolygons are not copied, and their vertices are transformed once. Then, every thread draws all of them,
+in order, in its own band of rows of the Raster, and the finished Raster is written to the file. */
+bool ConvexPolygon::drawPolygon(const vector<const ConvexPolygon*>& drawn, const vector<array<unsigned char, 4>>& rgba, ConvexPolygon& boundingBox,
+                                const string& nameFile, DrawMode mode, int width, int height) const {
+	Timer timer(drawMetric);
+	int count = drawn.size();
+	uint64_t vertices = 0;
+	for (int k = 0; k < count; ++k) vertices += drawn[k]->_points.size();
+	if (timer.active()) drawMetric.vertices.record(vertices);
+
+	double xmin, xmax, ymin, ymax;
+	boundingBox.getBounds(xmin, xmax, ymin, ymax);
+	double dx = 0 - xmin;
+	double dy = 0 - ymin;
 	
-	Point p = boundingBox._points[2];  
-	p += {dx, dy};			
+	Point p = {xmax + dx, ymax + dy};
 	
 	Point translator;
-	double scaleFactor = getScaleFactor(p, translator);
-	const int size = 500;	
-	pngwriter png(size, size, 1.0, nameFile.c_str());
-	for (int k = 0; k < insiders.size(); ++k) {
-		ConvexPolygon currentPolygon = polygons[insiders[k]];
-		int j = currentPolygon._points.size() - 1;
-		Point lastPoint = scaleAndTranslate(currentPolygon._points[j], dx, dy, scaleFactor, translator);	
-		for (int i = 0; i < currentPolygon._points.size(); ++i) {
-			Point currentPoint = scaleAndTranslate(currentPolygon._points[i], dx, dy, scaleFactor, translator);
-			png.line(currentPoint.get_x(), currentPoint.get_y(), lastPoint.get_x(), lastPoint.get_y(), colors[insiders[k]][0], colors[insiders[k]][1], colors[insiders[k]][2]);
-			j = i;
-			lastPoint = currentPoint;
+	double scaleFactor = getScaleFactor(p, translator, width, height);
+	vector<size_t> offsets(count + 1, 0);
+	vector<double> xs(vertices), ys(vertices);
+	vector<double> lowest(count), highest(count);
+	for (int k = 0; k < count; ++k) {
+		const VertexArray& points = drawn[k]->_points;
+		size_t first = offsets[k];
+		lowest[k] = numeric_limits<double>::infinity();
+		highest[k] = -numeric_limits<double>::infinity();
+		for (int i = 0; i < points.size(); ++i) {
+			xs[first + i] = (points[i].get_x() + dx)*scaleFactor + translator.get_x() - 1;
+			ys[first + i] = (points[i].get_y() + dy)*scaleFactor + translator.get_y() - 1;
+			lowest[k] = min(lowest[k], ys[first + i]);
+			highest[k] = max(highest[k], ys[first + i]);
 		}
+		offsets[k + 1] = first + points.size();
 	}
 
-	png.close();
-
+	Raster raster(width, height);
+	int bands = min(hardwareThreads(), height);
+	parallelFor(bands, [&](int t) {
+		int rowBegin = long(height)*t/bands;
+		int rowEnd = long(height)*(t + 1)/bands;
+		RasterScratch scratch;
+		for (int k = 0; k < count; ++k) {
+			if (highest[k] < rowBegin or lowest[k] >= rowEnd) continue;
+			raster.drawConvex(xs.data() + offsets[k], ys.data() + offsets[k], offsets[k + 1] - offsets[k], rgba[k].data(), mode == Fill, rowBegin, rowEnd, scratch);
+		}
+	});
+	return raster.writePng(nameFile);
 }
 
 /* The "p1" point lies on segment "p0p2" if its X coordinate is smaller than the maximum X coordinate between "p0" and "p2", 
@@ -344,81 +737,482 @@ bool ConvexPolygon::doIntersect(Point p1, Point q1, Point p2, Point q2, Point& i
     return false;
 }
 
-/* We create a point that has the same Y coordinate as the point p, and with infinite X. This point acts as an infinite line. 
-To know whether "p" is inside the polygon or not, we check how many edges intersect the infinite line. 
-The function returns "true" if the count of intersections is odd ("p" is inside the ConvexPolygon), and "false" otherwise. */
+/* Since the vertices are sorted clockwise, the rays that go from the first vertex P0 to the others turn clockwise too, and split the polygon 
+in triangles (wedges). First, we discard the points that are outside the angle between the first and the last edges, checking the points that lie 
+on those two edges. Then, a binary search finds the wedge 'P0 Pi Pi+1' that contains "p", and the side of the edge 'Pi Pi+1' where "p" lies 
+tells its position. Points and segments (polygons with less than three vertices) are handled apart. */
+PointPosition ConvexPolygon::pointPosition(const Point& p) const {
+	int size = _points.size();
+	if (size == 0) return Outside;
+	if (size == 1) return (p == _points[0]) ? Boundary : Outside;
+	if (size == 2) {
+		if (cross(_points[0], _points[1], p) == 0 and onSegment(_points[0], p, _points[1])) return Boundary;
+		return Outside;
+	}
+
+	const Point& p0 = _points[0];
+	double first = cross(p0, _points[1], p);
+	if (first > 0) return Outside;
+	if (first == 0) return onSegment(p0, p, _points[1]) ? Boundary : Outside;
+	double last = cross(p0, _points[size-1], p);
+	if (last < 0) return Outside;
+	if (last == 0) return onSegment(p0, p, _points[size-1]) ? Boundary : Outside;
+
+	int lo = 1;
+	int hi = size - 1;
+	while (hi - lo > 1) {
+		int mid = (lo + hi)/2;
+		if (cross(p0, _points[mid], p) <= 0) lo = mid;
+		else hi = mid;
+	}
+
+	double side = cross(_points[lo], _points[hi], p);
+	if (side < 0) return Inside;
+	return (side == 0) ? Boundary : Outside;
+}
+
+/* The points on the boundary also count as inside. */
 bool ConvexPolygon::PointInsidePolygon(Point p) const {
-	#define INF 10000          		// We define Infinite (Using INT_MAX causes overflow problems).
-	Point infinite = {INF, p.get_y()};      // We create a point for line segment from "p" to infinite.
-	int count = 0; 							
-	Point intersection;					
-	
-	/* If "p" is collinear with line segment 'i-j', we check whether it lies on the segment or not. If it does, we've finished.
-	Otherwise, if the infinite line intersects the segment 'i-j', we increase the counter. */
-    int j = _points.size() - 1; 
-	bool foundOnSegment = false;
-	for (int i = 0; i < _points.size() and not foundOnSegment; ++i) {
-		if (doIntersect(_points[i], _points[j], p, infinite, intersection)) {
-			if (orientation(_points[i], _points[j], p) == 0) {
-				if (not onSegment(_points[i], p, _points[j])) return false;
-				else foundOnSegment = true;
-			} 
-			++count;
-		}		
-		j = i;
-	} 
+	return pointPosition(p) != Outside;
+}
+
+/* Given a point "p" and a segment 'ab', it returns the square of the distance from "p" to the closest point of the segment. */
+static double squaredDistanceToSegment(const Point& p, const Point& a, const Point& b) {
+	double dx = b.get_x() - a.get_x();
+	double dy = b.get_y() - a.get_y();
+	double length = dx*dx + dy*dy;
+	double t = 0;
+	if (length > 0) t = max(0.0, min(1.0, ((p.get_x() - a.get_x())*dx + (p.get_y() - a.get_y())*dy)/length));
+	double ex = a.get_x() + t*dx - p.get_x();
+	double ey = a.get_y() + t*dy - p.get_y();
+	return ex*ex + ey*ey;
+}
+
+/* Outside the polygon, the closest point lies on one of its edges. */
+double ConvexPolygon::distanceTo(const Point& p) const {
+	int size = _points.size();
+	if (size == 0) return numeric_limits<double>::infinity();
+	if (pointPosition(p) != Outside) return 0;
+	double best = numeric_limits<double>::infinity();
+	for (int i = 0; i < size; ++i) best = min(best, squaredDistanceToSegment(p, _points[i], _points[(i + 1)%size]));
+	return sqrt(best);
+}
 
-	return (count%2) == 1;  
+/* By the separating axis theorem, two convex polygons have no point in common if and only if one of them is strictly on the outer side of an edge
+of the other. For the edges of the box, this is the comparison of the bounding boxes. For the edges of the polygon, the four corners of the box 
+are checked: going clockwise, the outer side is on the left. Points and segments are handled in the same way (a segment has its two sides as edges). */
+bool ConvexPolygon::overlapsBox(double xmin, double xmax, double ymin, double ymax) const {
+	int size = _points.size();
+	if (size == 0) return false;
+	double pxmin, pxmax, pymin, pymax;
+	getBounds(pxmin, pxmax, pymin, pymax);
+	if (pxmax < xmin or pxmin > xmax or pymax < ymin or pymin > ymax) return false;
+	const Point corners[4] = {Point(xmin, ymin), Point(xmin, ymax), Point(xmax, ymax), Point(xmax, ymin)};
+	for (int i = 0; i < size; ++i) {
+		Point a = _points[i];
+		Point b = _points[(i + 1)%size];
+		bool separated = true;
+		for (int c = 0; c < 4 and separated; ++c) separated = cross(a, b, corners[c]) > 0;
+		if (separated) return false;
+	}
+	return true;
 }
 
-/* First, we check whether the points of the first polygon (p1) are inside the second one (p2). In this case, we push them into the new vector "points", that will define the intersection of Polygon. 
-Next, we calculate the intersection points between the edges of the first and the second polygon and push them into the vector "points".
-Finally, we check whether the points of the second polygon are inside the first one. In this case, we push them into the vector "points". */
-ConvexPolygon ConvexPolygon::getIntersection(ConvexPolygon& p1, ConvexPolygon& p2) const{
-	vector<Point> points;
-	Point intersection;
+/* The points are classified in blocks. For every block, all the points do the same number of steps of the binary search of "pointPosition",
+so the body of each loop over the points has no branches and works on contiguous arrays. The vertices are first copied to separate arrays of 
+X and Y coordinates for the same reason. Polygons with less than three vertices use "pointPosition" directly. */
+void ConvexPolygon::pointPositions(const double* xs, const double* ys, int size, PointPosition* positions) const {
+	int n = _points.size();
+	if (n < 3) {
+		for (int i = 0; i < size; ++i) positions[i] = pointPosition(Point(xs[i], ys[i]));
+		return;
+	}
 
-	int j = p1._points.size() - 1;
-	int l = p2._points.size() - 1;
+	const double* px = _points.xs();
+	const double* py = _points.ys();
+	vector<double> vx(n), vy(n);
+	for (int i = 0; i < n; ++i) {
+		vx[i] = px[i] - px[0];      // Coordinates relative to the first vertex, as in the cross products of "pointPosition".
+		vy[i] = py[i] - py[0];
+	}
+	int steps = 0;
+	while ((1 << steps) < n) ++steps;
 
-	for (int i = 0; i < p1._points.size(); ++i) {
-		if (p2.PointInsidePolygon(p1._points[i]) == true) points.push_back(p1._points[i]);
-		for (int k = 0; k < p2._points.size(); ++k) {
-			if (doIntersect(p1._points[i], p1._points[j], p2._points[l], p2._points[k], intersection)) points.push_back(intersection);
-			l = k; 
+	const int blockSize = 1024;
+	int lo[blockSize], hi[blockSize];
+	double qx[blockSize], qy[blockSize];
+	for (int begin = 0; begin < size; begin += blockSize) {
+		int block = min(blockSize, size - begin);
+		for (int i = 0; i < block; ++i) {
+			qx[i] = xs[begin + i] - px[0];
+			qy[i] = ys[begin + i] - py[0];
+			lo[i] = 1;
+			hi[i] = n - 1;
+		}
+		for (int s = 0; s < steps; ++s) {
+			for (int i = 0; i < block; ++i) {
+				int mid = (lo[i] + hi[i]) >> 1;
+				bool right = vx[mid]*qy[i] - vy[mid]*qx[i] <= 0;
+				lo[i] = right ? mid : lo[i];
+				hi[i] = right ? hi[i] : mid;
+			}
+		}
+		for (int i = 0; i < block; ++i) {
+			double first = vx[1]*qy[i] - vy[1]*qx[i];
+			double last = vx[n-1]*qy[i] - vy[n-1]*qx[i];
+			int l = lo[i], h = hi[i];
+			double side = (px[h] - px[l])*(ys[begin + i] - py[l]) - (py[h] - py[l])*(xs[begin + i] - px[l]);
+			PointPosition position = (side < 0) ? Inside : ((side == 0) ? Boundary : Outside);
+			if (first >= 0 or last <= 0) position = pointPosition(Point(xs[begin + i], ys[begin + i]));    // On the first or last ray, or beyond them.
+			positions[begin + i] = position;
 		}
+	}
+}
 
-		j = i;
+/* Given the vertices of a ConvexPolygon (clockwise, starting from the point with the lowest X coordinate), it stores in "upper" and "lower" 
+its upper and lower chains, both from left to right. Every chain is a function of the X coordinate: when the polygon has a vertical edge at
+one of its ends, only the top point of that edge goes to the upper chain and only the bottom one goes to the lower chain. */
+static void getChains(const VertexArray& hull, vector<Point>& upper, vector<Point>& lower) {
+	int size = hull.size();
+	upper.clear();
+	lower.clear();
+	if (size == 0) return;
+	int right = 0;    // Position of the point with the biggest X coordinate (and biggest Y in case of a tie).
+	for (int i = 1; i < size; ++i) {
+		if (hull[i].get_x() > hull[right].get_x() or (hull[i].get_x() == hull[right].get_x() and hull[i].get_y() > hull[right].get_y())) right = i;
 	}
 
-	j = p2._points.size() - 1;
-	l = p1._points.size() - 1;
+	int first = (size > 1 and hull[1].get_x() == hull[0].get_x()) ? 1 : 0;
+	for (int i = first; i <= right; ++i) upper.push_back(hull[i]);
 
-	for (int i = 0; i < p2._points.size(); ++i) {
-		if (p1.PointInsidePolygon(p2._points[i]) == true) points.push_back(p2._points[i]);
-		j = i;
-	} 
+	lower.push_back(hull[0]);
+	for (int i = size - 1; i > 0 and i >= right; --i) lower.push_back(hull[i]);
+	if (lower.size() > 1 and hull[(right + 1)%size].get_x() == hull[right].get_x()) lower.pop_back();
+}
 
-	ConvexPolygon intersectionPolygon(points);
-	return intersectionPolygon;
+/* The struct "ChainCursor" evaluates a chain at increasing X coordinates, so that walking the whole chain costs linear time. 
+When the X coordinate is the one of a vertex, the Y coordinate of the vertex is returned exactly and "atVertex" becomes "true". */
+struct ChainCursor {
+	const vector<Point>& chain;
+	int i;
+	bool atVertex;
+	ChainCursor(const vector<Point>& c) : chain(c), i(0), atVertex(false) {}
+
+	double valueAt(double x) {
+		while (i + 1 < int(chain.size()) and chain[i+1].get_x() <= x) ++i;
+		atVertex = (chain[i].get_x() == x);
+		if (i + 1 == int(chain.size()) or atVertex) return chain[i].get_y();
+		const Point& p0 = chain[i];
+		const Point& p1 = chain[i+1];
+		return p0.get_y() + (p1.get_y() - p0.get_y())*(x - p0.get_x())/(p1.get_x() - p0.get_x());
+	}
+};
+
+/* The struct "Sample" stores, for a given X coordinate, the top (U) and bottom (L) Y coordinates of the intersection at that X,
+and whether the top and the bottom boundaries turn there (otherwise, the sample is in the middle of an edge and is not a vertex). */
+struct Sample {
+	double x, u, l;
+	bool uCorner, lCorner;
+};
+
+/* Given the values of two chains at the same X coordinate and whether they have a vertex there, it returns whether the minimum 
+(or maximum, when "takeMin" is "false") of both chains has a vertex there. When both values are equal, the chains either cross 
+or touch there (a vertex) or they lie on the same line, which only happens if they were already equal at the previous sample. */
+static bool isCorner(double v1, bool vertex1, double v2, bool vertex2, bool takeMin, bool equalBefore) {
+	if (v1 == v2) return vertex1 or vertex2 or not equalBefore;
+	return ((v1 < v2) == takeMin) ? vertex1 : vertex2;
 }
 
-/* We make a new vector "points" that contains both the points in the first given ConvexPolygon (p1) and the points in the second given ConvexPolygon (p2).
-Finally, we create a new polygon "unionPolygon", that will be defined by the ConvexHull of the vector "points". */
-ConvexPolygon ConvexPolygon::getUnion(ConvexPolygon& p1, ConvexPolygon& p2) const{
-	vector<Point> points = p1._points;
-	for (int i = 0; i < p2._points.size(); ++i) {
-		points.push_back(p2._points[i]);
+/* Adds "sample" at the end of "samples". A crossing computed with rounding errors may fall on the X coordinate of the sample before or after it,
+and then both are merged into a single sample (which keeps the values of the sample that is not a crossing, and the corners of both),
+so no vertex is repeated. */
+static void addSample(vector<Sample>& samples, const Sample& sample, bool crossing) {
+	if (samples.empty() or samples.back().x != sample.x) {
+		samples.push_back(sample);
+		return;
 	}
-	ConvexPolygon unionPolygon(points);
-	
+	Sample& previous = samples.back();
+	bool uCorner = previous.uCorner or sample.uCorner, lCorner = previous.lCorner or sample.lCorner;
+	if (not crossing) previous = sample;
+	previous.uCorner = uCorner;
+	previous.lCorner = lCorner;
+}
+
+/* Given two samples whose values of "f" have different signs, it returns the X coordinate where the linear function that joins them is "0". */
+static double crossingX(double x0, double f0, double x1, double f1) {
+	return x0 + (x1 - x0)*f0/(f0 - f1);
+}
+
+/* Given a vector of points that go around a convex polygon, it removes the repeated consecutive points and the points that are collinear 
+with their two neighbours (up to rounding errors: the sine of the angle between both edges is below 1e-9), and rotates the vector so that it starts with the point with the lowest X coordinate (and lowest Y in case of a tie). 
+"clean" and "kept" are buffers for the intermediate results. */
+static void removeCollinear(vector<Point>& points, vector<Point>& clean, vector<Point>& kept) {
+	clean.clear();
+	for (const Point& p : points) {
+		if (clean.empty() or clean.back() != p) clean.push_back(p);
+	}
+	while (clean.size() > 1 and clean.back() == clean[0]) clean.pop_back();
+
+	bool removed = true;
+	while (removed and clean.size() >= 3) {
+		removed = false;
+		kept.clear();
+		int size = clean.size();
+		for (int i = 0; i < size; ++i) {
+			const Point& previous = kept.empty() ? clean[size-1] : kept.back();
+			const Point& next = clean[(i+1)%size];
+			double tolerance = 1e-9*previous.distance(clean[i])*clean[i].distance(next);
+			if (abs(cross(previous, clean[i], next)) <= tolerance) removed = true;
+			else kept.push_back(clean[i]);
+		}
+		clean.swap(kept);
+	}
+
+	if (not clean.empty()) {
+		int first = 0;
+		for (int i = 1; i < int(clean.size()); ++i) if (lowerXY(clean[i], clean[first])) first = i;
+		rotate(clean.begin(), clean.begin() + first, clean.end());
+	}
+	points.swap(clean);
+}
+
+/* Buffers of the intersection and union of two ConvexPolygons. Every thread has its own ones, which keep their memory from one call to the next,
+so that the operations on small polygons do not allocate memory once the buffers have grown. */
+struct BooleanScratch {
+	vector<Point> chains[4];            // Upper and lower chains of both polygons.
+	vector<double> xs, chainXs, merged; // X coordinates of the samples.
+	vector<Sample> samples;
+	vector<Point> vertices, clean, kept;
+	vector<Point> sorted[2], upper, lower, points;    // Vertices of both polygons sorted by X coordinate, and all of them together.
+};
+
+static BooleanScratch& booleanScratch() {
+	static thread_local BooleanScratch scratch;
+	return scratch;
+}
+
+/* Given a segment AB and a ConvexPolygon with at least three vertices (clockwise), it stores in "points" the ends of the part of AB inside the polygon.
+Every edge keeps the points of AB on its right side or on it: where AB crosses the line of the edge, it cuts the parameter range [tMin, tMax] of AB
+from below (when A is outside that edge) or from above. The ends that are not cut keep the exact coordinates of A and B. */
+static void clipSegment(const Point& A, const Point& B, const VertexArray& polygon, vector<Point>& points) {
+	int size = polygon.size();
+	double tMin = 0, tMax = 1;
+	for (int i = 0; i < size; ++i) {
+		const Point& p0 = polygon[i];
+		const Point& p1 = polygon[(i+1)%size];
+		double cA = cross(p0, p1, A), cB = cross(p0, p1, B);
+		if (cA > 0 and cB > 0) return;
+		if (cA <= 0 and cB <= 0) continue;
+		double t = cA/(cA - cB);
+		if (cA > 0) tMin = max(tMin, t);
+		else tMax = min(tMax, t);
+	}
+	if (tMin > tMax) return;
+	double dx = B.get_x() - A.get_x(), dy = B.get_y() - A.get_y();
+	points.push_back(tMin == 0 ? A : Point(A.get_x() + dx*tMin, A.get_y() + dy*tMin));
+	points.push_back(tMax == 1 ? B : Point(A.get_x() + dx*tMax, A.get_y() + dy*tMax));
+}
+
+/* Given two segments AB and CD, it stores in "points" their common point, or the ends of their common part when they are collinear and overlap. */
+static void intersectSegments(const Point& A, const Point& B, const Point& C, const Point& D, vector<Point>& points) {
+	double d1 = cross(A, B, C), d2 = cross(A, B, D);
+	if (d1 == 0 and d2 == 0) {
+		Point low1 = min(A, B, lowerXY), high1 = max(A, B, lowerXY);
+		Point low2 = min(C, D, lowerXY), high2 = max(C, D, lowerXY);
+		Point low = max(low1, low2, lowerXY), high = min(high1, high2, lowerXY);
+		if (lowerXY(high, low)) return;
+		points.push_back(low);
+		points.push_back(high);
+		return;
+	}
+	double d3 = cross(C, D, A), d4 = cross(C, D, B);
+	if ((d1 > 0 and d2 > 0) or (d1 < 0 and d2 < 0) or (d3 > 0 and d4 > 0) or (d3 < 0 and d4 < 0)) return;
+	if (d1 == 0) points.push_back(C);
+	else if (d2 == 0) points.push_back(D);
+	else if (d3 == 0) points.push_back(A);
+	else if (d4 == 0) points.push_back(B);
+	else {
+		double t = d3/(d3 - d4);
+		points.push_back(Point(A.get_x() + (B.get_x() - A.get_x())*t, A.get_y() + (B.get_y() - A.get_y())*t));
+	}
+}
+
+/* Inside the common X range of both polygons, the intersection is the set of points below both upper chains and above both lower chains.
+Its top boundary is therefore the minimum of the two upper chains, and its bottom boundary the maximum of the two lower chains.
+We sweep the four chains at the same time from left to right: at every vertex X coordinate of any chain, and at every X coordinate where
+the two upper (or the two lower) chains cross, we store a sample with the top and bottom boundaries. Between two samples both boundaries are linear,
+and their difference is a concave function, so the samples where the top is above the bottom are contiguous.
+Finally, the top boundary of those samples (from left to right) and the bottom one (from right to left) give the vertices in clockwise order.
+The whole process takes O(n + m) time, and no convex hull has to be built.
+A point or a segment has no area to sweep, so it is tested against the other polygon directly: the point with "pointPosition",
+and the segment by clipping it against the edges of the other polygon (or intersecting both segments). */
+ConvexPolygon ConvexPolygon::getIntersection(const ConvexPolygon& p1, const ConvexPolygon& p2) const{
+	Timer timer(intersectionMetric, p1._points.size() + p2._points.size());
+	ConvexPolygon intersectionPolygon;
+	if (p1._points.empty() or p2._points.empty()) return intersectionPolygon;
+
+	BooleanScratch& scratch = booleanScratch();
+	const ConvexPolygon& small = (p1._points.size() <= p2._points.size()) ? p1 : p2;
+	const ConvexPolygon& other = (p1._points.size() <= p2._points.size()) ? p2 : p1;
+	if (small._points.size() <= 2) {
+		vector<Point>& vertices = scratch.vertices;
+		vertices.clear();
+		if (small._points.size() == 1) {
+			if (other.pointPosition(small._points[0]) != Outside) vertices.push_back(small._points[0]);
+		}
+		else if (other._points.size() == 2) intersectSegments(small._points[0], small._points[1], other._points[0], other._points[1], vertices);
+		else clipSegment(small._points[0], small._points[1], other._points, vertices);
+		removeCollinear(vertices, scratch.clean, scratch.kept);
+		intersectionPolygon.setVertices(vertices);
+		return intersectionPolygon;
+	}
+
+	vector<Point>& upper1 = scratch.chains[0];
+	vector<Point>& lower1 = scratch.chains[1];
+	vector<Point>& upper2 = scratch.chains[2];
+	vector<Point>& lower2 = scratch.chains[3];
+	getChains(p1._points, upper1, lower1);
+	getChains(p2._points, upper2, lower2);
+	double a = max(upper1[0].get_x(), upper2[0].get_x());
+	double b = min(upper1.back().get_x(), upper2.back().get_x());
+	if (a > b) return intersectionPolygon;
+
+	/* All the X coordinates of the vertices inside [a, b], merged in increasing order. */
+	vector<double>& xs = scratch.xs;
+	vector<double>& chainXs = scratch.chainXs;
+	vector<double>& merged = scratch.merged;
+	xs.assign(1, a);
+	for (int c = 0; c < 4; ++c) {
+		chainXs.clear();
+		for (const Point& vertex : scratch.chains[c]) {
+			double x = vertex.get_x();
+			if (x > a and x < b) chainXs.push_back(x);
+		}
+		merged.resize(xs.size() + chainXs.size());
+		merge(xs.begin(), xs.end(), chainXs.begin(), chainXs.end(), merged.begin());
+		xs.swap(merged);
+	}
+	xs.push_back(b);
+	xs.erase(unique(xs.begin(), xs.end()), xs.end());
+
+	ChainCursor u1(upper1), l1(lower1), u2(upper2), l2(lower2);
+	vector<Sample>& samples = scratch.samples;
+	samples.clear();
+	double pu1 = 0, pu2 = 0, pl1 = 0, pl2 = 0;
+	for (int k = 0; k < int(xs.size()); ++k) {
+		double x = xs[k];
+		double cu1 = u1.valueAt(x), cu2 = u2.valueAt(x), cl1 = l1.valueAt(x), cl2 = l2.valueAt(x);
+		if (k > 0) {
+			double px = xs[k-1];
+			pair<double, bool> crossings[2];    // X coordinate of the crossing and whether it is between the upper chains.
+			int count = 0;
+			if ((pu1 - pu2)*(cu1 - cu2) < 0) crossings[count++] = {crossingX(px, pu1 - pu2, x, cu1 - cu2), true};
+			if ((pl1 - pl2)*(cl1 - cl2) < 0) crossings[count++] = {crossingX(px, pl1 - pl2, x, cl1 - cl2), false};
+			sort(crossings, crossings + count);
+			for (int c = 0; c < count; ++c) {
+				double t = (crossings[c].first - px)/(x - px);
+				double iu1 = pu1 + (cu1 - pu1)*t, iu2 = pu2 + (cu2 - pu2)*t;
+				double il1 = pl1 + (cl1 - pl1)*t, il2 = pl2 + (cl2 - pl2)*t;
+				addSample(samples, {crossings[c].first, min(iu1, iu2), max(il1, il2), crossings[c].second, not crossings[c].second}, true);
+			}
+		}
+		bool uCorner = isCorner(cu1, u1.atVertex, cu2, u2.atVertex, true, k > 0 and pu1 == pu2);
+		bool lCorner = isCorner(cl1, l1.atVertex, cl2, l2.atVertex, false, k > 0 and pl1 == pl2);
+		addSample(samples, {x, min(cu1, cu2), max(cl1, cl2), uCorner, lCorner}, false);
+		pu1 = cu1; pu2 = cu2; pl1 = cl1; pl2 = cl2;
+	}
+
+	int first = -1, last = -1;
+	for (int k = 0; k < int(samples.size()); ++k) {
+		if (samples[k].u >= samples[k].l) {
+			if (first == -1) first = k;
+			last = k;
+		}
+	}
+	if (first == -1) return intersectionPolygon;
+
+	/* The ends of the intersection: a vertical segment at a sample, or a single point where the top and bottom boundaries meet. */
+	Point leftLow(samples[first].x, samples[first].l), leftHigh(samples[first].x, samples[first].u);
+	if (first > 0) {
+		const Sample& s0 = samples[first-1];
+		const Sample& s1 = samples[first];
+		double x = crossingX(s0.x, s0.u - s0.l, s1.x, s1.u - s1.l);
+		double t = (x - s0.x)/(s1.x - s0.x);
+		leftLow = leftHigh = Point(x, s0.u + (s1.u - s0.u)*t);
+	}
+	Point rightLow(samples[last].x, samples[last].l), rightHigh(samples[last].x, samples[last].u);
+	if (last + 1 < int(samples.size())) {
+		const Sample& s0 = samples[last];
+		const Sample& s1 = samples[last+1];
+		double x = crossingX(s0.x, s0.u - s0.l, s1.x, s1.u - s1.l);
+		double t = (x - s0.x)/(s1.x - s0.x);
+		rightLow = rightHigh = Point(x, s0.u + (s1.u - s0.u)*t);
+	}
+
+	vector<Point>& vertices = scratch.vertices;
+	vertices.clear();
+	vertices.push_back(leftLow);
+	vertices.push_back(leftHigh);
+	for (int k = first; k <= last; ++k) if (samples[k].uCorner) vertices.push_back(Point(samples[k].x, samples[k].u));
+	vertices.push_back(rightHigh);
+	vertices.push_back(rightLow);
+	for (int k = last; k >= first; --k) if (samples[k].lCorner) vertices.push_back(Point(samples[k].x, samples[k].l));
+	removeCollinear(vertices, scratch.clean, scratch.kept);
+
+	intersectionPolygon.setVertices(vertices);
+	return intersectionPolygon;
+}
+
+/* The vertices of both ConvexPolygons are obtained sorted by X coordinate in linear time, and merged. Since the union is the convex hull 
+of all these vertices, it is enough to build the upper and lower chains over the merged vector: the chains find the bridges between both polygons
+and drop the vertices that are hidden by them. The whole process takes O(n + m) time, without sorting. */
+ConvexPolygon ConvexPolygon::getUnion(const ConvexPolygon& p1, const ConvexPolygon& p2) const{
+	Timer timer(unionMetric, p1._points.size() + p2._points.size());
+	BooleanScratch& scratch = booleanScratch();
+	vector<Point>& sorted1 = scratch.sorted[0];
+	vector<Point>& sorted2 = scratch.sorted[1];
+	vector<Point>& points = scratch.points;
+	sortedVertices(p1._points, sorted1, scratch.upper, scratch.lower);
+	sortedVertices(p2._points, sorted2, scratch.upper, scratch.lower);
+	points.resize(sorted1.size() + sorted2.size());
+	merge(sorted1.begin(), sorted1.end(), sorted2.begin(), sorted2.end(), points.begin(), lowerXY);
+	points.erase(unique(points.begin(), points.end()), points.end());
+
+	ConvexPolygon unionPolygon;
+	vector<Point>& hull = hullScratch().hull;
+	hullOfSortedPoints(points, 1, hull);
+	unionPolygon.setVertices(hull);
 	return unionPolygon;
 }
 
+/* The polygons are combined two by two, like the rounds of a tournament: in every round, the union of the polygons in positions "i" and "i + step" 
+is stored in position "i", so after log(n) rounds the first position has the union of all of them. The unions of each round are independent,
+and they are split between the available threads. The union of two polygons is made directly, without copying them. */
+ConvexPolygon ConvexPolygon::getUnion(const vector<const ConvexPolygon*>& polygons) const {
+	int size = polygons.size();
+	if (size == 0) return ConvexPolygon();
+	if (size <= 2) return size == 1 ? *polygons[0] : getUnion(*polygons[0], *polygons[1]);
+	vector<ConvexPolygon> partial(size);
+	for (int i = 0; i < size; ++i) partial[i] = *polygons[i];
+
+	for (int step = 1; step < size; step *= 2) {
+		int unions = (size + 2*step - 1)/(2*step);
+		int tasks = min(unions, hardwareThreads());
+		parallelFor(tasks, [&](int t) {
+			for (int u = t; u < unions; u += tasks) {
+				int i = u*2*step;
+				if (i + step < size) partial[i] = getUnion(partial[i], partial[i + step]);
+			}
+		});
+	}
+	return partial[0];
+}
+
 /* We check whether all the vertices of the given ConvexPolygon are inside the own ConvexPolyogn.
 If we find a point that is not inside it, we return "false". 
 Otherwise, we return "true". */
-bool ConvexPolygon::inside(ConvexPolygon secondPolygon) const {
+bool ConvexPolygon::inside(const ConvexPolygon& secondPolygon) const {
+	Timer timer(insideMetric, _points.size() + secondPolygon._points.size());
 	for (int i = 0; i < _points.size(); ++i) {
 		if (not secondPolygon.PointInsidePolygon(_points[i])) {
 			return false;
@@ -445,7 +1239,7 @@ In case it is inside, we check which of the edges will intersect the segment tha
 and according to that, we find the "intersection" point. 
 In case it is outside, we go through all the edges of the framework until we find the one that intersects the segment that goes from "farthestPoint to the center (250, 250).
 When found, we store in the variable "intersection" the intersection point. */
-double ConvexPolygon::getCenteredScaleFactor(Point farthestPoint, ConvexPolygon framework, Point center) const{
+double ConvexPolygon::getCenteredScaleFactor(Point farthestPoint, const ConvexPolygon& framework, Point center) const{
 	Point intersection;																		  																					
     if (framework.PointInsidePolygon(farthestPoint)) {	
     	double x = farthestPoint.get_x();
@@ -523,7 +1317,7 @@ void ConvexPolygon::scaleCenteredPolygon(vector<Point>& newpoints) {
 /* We create a copy of the vector of points.
 We scale the points of the new vector and then draw edge by edge in a PNG file, with its associated color. */
 void ConvexPolygon::drawCenteredPolygon(vector<double> colors, pngwriter& png) {
-	vector<Point> newpoints = _points;
+	vector<Point> newpoints = _points.toPoints();
 	scaleCenteredPolygon(newpoints);
 	int j = newpoints.size() - 1;
 	for (int i = 0; i < newpoints.size(); ++i) {
@@ -5,20 +5,53 @@
 #include <pngwriter.h>
 #include <sstream>
 #include <map>
+#include <array>
 #include "Point.hh"
+#include "VertexArray.hh"
 using namespace std;
 
 /* The ConvexPolygon class stores a vector of two dimensional points in the plane and provides some usefull operations. 
+Copies of a ConvexPolygon share its vertices, so they are made in O(1) time; the vertices are only copied when one of the copies changes them.
 Invariant: all the points of a ConvexPolygon form a Convex Hull. */
 
+/** Algorithms that can be used to build the convex hull of a set of points.
+	"MonotoneChain" sorts the points by X coordinate using only cross products and builds the hull in parallel for big inputs.
+	"GrahamScan" is the original slope-based scan, kept for comparison. Both return the vertices in the same clockwise order. */
+enum HullEngine { MonotoneChain, GrahamScan };
+
+/** Enables or disables the prefilter of "convexHull", which discards the points strictly inside the polygon formed by the extreme points 
+	in eight directions before building the hull of big inputs with the monotone chain. The hull is the same either way. It is enabled by default. */
+void setHullPrefilter(bool enabled);
+
+/** Returns "true" if the prefilter of "convexHull" is enabled. */
+bool hullPrefilter();
+
+/** Ways of drawing a ConvexPolygon: only the pixels touched by its boundary, or all the pixels that it touches. */
+enum DrawMode { Outline, Fill };
+
+/** Position of a point with respect to a ConvexPolygon. */
+enum PointPosition { Outside, Boundary, Inside };
+
 class ConvexPolygon {
 
 public:
-	/** Constructor. */
-	ConvexPolygon(std::vector<Point> v);
+	/** Constructor. The vertices are the convex hull of "v", built with the given engine. */
+	ConvexPolygon(std::vector<Point> v, HullEngine engine = MonotoneChain);
 	
 	/** Constructor. */
 	ConvexPolygon();  
+
+	/** Returns the ConvexPolygon whose vertices are the convex hull of "points", built with the given engine. 
+		Unlike the constructor, it does not copy the points: they are sorted in place. */
+	static ConvexPolygon fromPoints(vector<Point>& points, HullEngine engine = MonotoneChain);
+
+	/** Returns a ConvexPolygon whose vertices are the given ones, without building their convex hull again.
+		Pre: the vertices already form a convex hull, in clockwise order starting from the one with the lowest X coordinate. */
+	static ConvexPolygon fromHull(const VertexArray& hull);
+
+	/** Makes the ConvexPolygon use the coordinates stored in "points" instead of its own ones, keeping its cached properties.
+		Pre: "points" has the same vertices as the ConvexPolygon, in the same order. */
+	void setStorage(const VertexArray& points);
 	
 	/** Given a vector of points, returns the position of the point with lowest X coordinate. 
 		In case of a tie, the one with lowest Y coordinate. */
@@ -26,7 +59,20 @@ public:
 	
 	/** Given a vector of points, returns a new vector of points with the points
 		that are the vertices of a ConvexPolygon, so that all inside angles are <180 degrees. */
-	vector<Point> convexHull(vector<Point>& points); 
+	vector<Point> convexHull(vector<Point>& points, HullEngine engine = MonotoneChain); 
+
+	/** Given a vector of points, stores in "hull" the vertices of their convex hull (in the same order as "convexHull"), reusing its memory. 
+		The order of "points" changes, and the points that are not needed may be removed from it. */
+	void convexHull(vector<Point>& points, vector<Point>& hull, HullEngine engine = MonotoneChain);
+
+	/** Adds the point "p" to the ConvexPolygon, which becomes the convex hull of its vertices and "p", without building the hull again.
+		A point inside the ConvexPolygon or on its boundary is rejected in O(log n) time. For a point outside it, the two tangents are found 
+		in O(log n) time, and the vertices that it hides are replaced by it with a single move of the coordinate arrays. Returns "true" if the vertices change. */
+	bool addPoint(const Point& p);
+
+	/** Adds the given points one after another, like "addPoint". When many of them are outside the ConvexPolygon, the hull is built again instead,
+		in O(n + k log k) time for k points outside. Returns "true" if the vertices change. */
+	bool addPoints(const vector<Point>& points);
 	
 	/** Prints the X and Y coordinates of the vertices of a ConvexPolygon. */	
 	void printVertices() const;
@@ -45,35 +91,92 @@ public:
 	
 	/** Returns the centroid of a ConvexPolygon. */
 	Point getCentroid() const;
-	
-	/** Given a set of polygons, returns the smallest bounding box that contains all of them.*/
-	ConvexPolygon boundingBox(map<string, ConvexPolygon>& polygons, const vector<string>& insiders) const; 
 
-	/** Given a set of ConvexPolygons, draws them in a PNG file with the name of the string "nameFile", each one with its associated color, with white background and 
-		the coordinates of the vertices scaled to fit in the 498x498 central part of the image, while preserving the original aspect ratio.*/
-	void drawPolygon(map<string, ConvexPolygon>& polygons, map<string, vector<double>>& colors, vector<string> insiders, ConvexPolygon& boundingBox, string nameFile) const;
+	/** Returns the vertices of a ConvexPolygon, in clockwise order starting from the one with the lowest X coordinate. */
+	const VertexArray& getPoints() const;
 
-	/** Returns the intersection ConvexPolygon between two given ConvexPolygons. */
-	ConvexPolygon getIntersection(ConvexPolygon& p1, ConvexPolygon& p2) const;
+	/** Stores in "xmin", "xmax", "ymin" and "ymax" the limits of the axis-aligned bounding box of a ConvexPolygon. 
+		Pre: the ConvexPolygon has at least one vertex. */
+	void getBounds(double& xmin, double& xmax, double& ymin, double& ymax) const;
+	
+	/** Given a set of polygons, returns the smallest bounding box that contains all of them. Empty polygons are ignored, 
+		so the bounding box is empty when all of them are empty (or there are none).*/
+	ConvexPolygon boundingBox(const vector<const ConvexPolygon*>& polygons) const; 
+
+	/** Given a set of ConvexPolygons, draws them in a PNG file with the name of the string "nameFile", each one with its color in "colors", with white background and 
+		the coordinates of the vertices scaled to fit in the image without its outer pixels, while preserving the original aspect ratio.
+		The colors are given by their red, green, blue and alpha values, from 0 to 255. 
+		The ConvexPolygons are drawn in order, blended with what is below them, in row bands split between the available threads.
+		Returns "false" if the file cannot be written. */
+	bool drawPolygon(const vector<const ConvexPolygon*>& polygons, const vector<array<unsigned char, 4>>& colors, ConvexPolygon& boundingBox,
+		const string& nameFile, DrawMode mode = Outline, int width = 500, int height = 500) const;
+
+	/** Returns the intersection ConvexPolygon between two given ConvexPolygons, in O(n + m) time. 
+		The vertices are produced directly in clockwise order, so no convex hull is built. */
+	ConvexPolygon getIntersection(const ConvexPolygon& p1, const ConvexPolygon& p2) const;
 	
-	/** Returns the union ConvexPolygon between two given ConvexPolygons. */
-	ConvexPolygon getUnion(ConvexPolygon& p1, ConvexPolygon& p2) const;
+	/** Returns the union ConvexPolygon between two given ConvexPolygons, in O(n + m) time. */
+	ConvexPolygon getUnion(const ConvexPolygon& p1, const ConvexPolygon& p2) const;
+
+	/** Given a set of polygons, returns the union ConvexPolygon of all of them. The unions are done in a balanced tree, using several threads. */
+	ConvexPolygon getUnion(const vector<const ConvexPolygon*>& polygons) const;
+
+	/** Returns the position of the point "p" with respect to the ConvexPolygon, in O(log n) time. */
+	PointPosition pointPosition(const Point& p) const;
+
+	/** Given a point "p", returns "true" if it is inside the ConvexPolygon or on its boundary. */
+	bool PointInsidePolygon(Point p) const;
+
+	/** Returns the distance from the point "p" to the ConvexPolygon ("0" if it is inside or on its boundary, infinity if the ConvexPolygon has no vertices). */
+	double distanceTo(const Point& p) const;
+
+	/** Returns "true" if the ConvexPolygon and the axis-aligned box [xmin, xmax] x [ymin, ymax] have some point in common. */
+	bool overlapsBox(double xmin, double xmax, double ymin, double ymax) const;
+
+	/** Given the X and Y coordinates of "size" points, stores in "positions" the position of each one of them with respect to the ConvexPolygon.
+		All the points advance through the binary search at the same time, so the loops over the points can be vectorized. */
+	void pointPositions(const double* xs, const double* ys, int size, PointPosition* positions) const;
 
 	/** Returns "true" if the given ConvexPolygon is inside the own ConvexPolygon. */
-	bool inside(ConvexPolygon cp) const;
+	bool inside(const ConvexPolygon& cp) const;
 	
 	/** Draws a ConvexPolygon in a given PNG file, with its associated color and white background, so that its centroid becomes the point (250, 250)
 		and at least one of its vertices remains in one of the edges of the 498x498 square, while preserving the original aspect ratio. */
 	void drawCenteredPolygon(vector<double> colors, pngwriter& png);
 
-	std::vector<Point> _points;
-
 private:
 
+	/** Vertices of the ConvexPolygon, stored as arrays of X and Y coordinates. They can only be changed with "setVertices", 
+		so that the cached properties remain valid. */
+	VertexArray _points;
+
+	/** Properties derived from the vertices. They are computed all together the first time that one of them is needed,
+		and "_cached" is "false" while they are not valid. */
+	mutable bool _cached;
+	mutable double _area, _perimeter;
+	mutable Point _centroid;
+	mutable double _xmin, _xmax, _ymin, _ymax;
+
+	/** Replaces the vertices of the ConvexPolygon and invalidates its cached properties. */
+	void setVertices(const vector<Point>& points);
+
+	/** Adds the points in [first, last), like "addPoints". */
+	bool addPoints(const Point* first, const Point* last);
+
+	/** Computes the area, perimeter, centroid and bounds of the ConvexPolygon in a single pass over the vertices, unless they are already cached. */
+	void computeProperties() const;
+
 	/** Given a vector of points, sorts them so that the first point in the vector is the one with lowest X coordinate and, in case of a tie, the one with lowest Y coordinate. 
 		The other points are sorted in clockwise order. */
 	void sortPoints(vector<Point>& points);
 
+	/** Stores in "hull" the convex hull of the given points, built with the slope-based Graham scan. */
+	void grahamScan(vector<Point>& points, vector<Point>& hull);
+
+	/** Stores in "hull" the convex hull of the given points, built with Andrew's monotone chain. The points are sorted by X coordinate (and Y in case of a tie) 
+		and, for big inputs, the sort and the construction of the chains are split between several threads. */
+	void monotoneChain(vector<Point>& points, vector<Point>& hull) const;
+
 	/** Given three points, returns "0" if they are collinear, returns "1" if they make a left turn or returns "2" otherwise. */
 	int orientation(Point p1, Point p2, Point p3) const;
 
@@ -82,12 +185,12 @@ private:
 		The same with ymax and ymin. */
 	void lowestAndBiggest(double& xmax, double& xmin, double& ymax, double& ymin, Point p) const;
 
-	/** Given two points, returns the sclaeFactor that multiplied by "p" moves this point to one of the edges of a 498x498 square.
-		and stores in "translator" the value needed to tranlate a scaled polygon to the middle of the 498x498 square. */
-	double getScaleFactor(Point p, Point& translator) const;
+	/** Given two points, returns the sclaeFactor that multiplied by "p" moves this point to one of the edges of a (width - 2)x(height - 2) rectangle.
+		and stores in "translator" the value needed to tranlate a scaled polygon to the middle of the rectangle. */
+	double getScaleFactor(Point p, Point& translator, int width = 500, int height = 500) const;
 
 	/** Modifies the X and Y coordinate of a given point p by applying some different operations. */
-	Point scaleAndTranslate(Point& p, double dx, double dy, double scaleFacto, Point& translator) const;
+	Point scaleAndTranslate(const Point& p, double dx, double dy, double scaleFacto, Point& translator) const;
 
 	/** Given three collinear points "p0", "p1" and "p2", returns "true" if "p1" lies on the segment 'p0p2'. 
 		Otherwise, returns "false". */
@@ -97,16 +200,13 @@ private:
 		and stores the intersection point in the variable "intersection". */
 	bool doIntersect(Point p1, Point q1, Point p2, Point q2, Point& intersection) const;
 
-	/** Given a point "p", returns "true" if it is inside the ConvexPolygon. */
-	bool PointInsidePolygon(Point p) const;
-
 	/** Given a point "p", calculates its distance to the point (250, 250) and if its bigger than the "maxDistance", 
 		"maxDistance" becomes the values calculated and the point "farthestPoint" stores the point "p". */
 	void getFarthestPoint(Point p, Point& farthestPoint, double& maxDistance) const;
 
 	/** Returns the scaleFactor need to scale a centered Polygon so that at least one of its vertices intersects one of the edges 
 		of a given framework. */
-	double getCenteredScaleFactor(Point p, ConvexPolygon framework, Point center) const;
+	double getCenteredScaleFactor(Point p, const ConvexPolygon& framework, Point center) const;
 
 	/** Modifies a given vector of points so that they fit in the center of a 489x489 square, preserving the original aspect ratio. */
 	void scaleCenteredPolygon(vector<Point>& points);
@@ -0,0 +1,92 @@
+#include "FastParse.hh"
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+using namespace std;
+
+/* Powers of ten that are exactly representable as doubles. */
+static const double powersOfTen[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+void parseWord(const char*& p, const char* end, const char*& word, size_t& size) {
+	skipBlanks(p, end);
+	word = p;
+	while (p != end and not isBlank(*p)) ++p;
+	size = p - word;
+}
+
+static bool isDigit(char c) {
+	return c >= '0' and c <= '9';
+}
+
+/* First, we find the extent of the number while accumulating its significant digits in an integer "mantissa" and its decimal exponent.
+When the mantissa has at most 19 digits, is below 2^53 and the exponent is between -22 and 22, both the mantissa and the power of ten are exact
+doubles, so a single multiplication or division gives the correctly rounded result (Clinger's fast path).
+Otherwise, the characters of the number are converted with "strtod". */
+bool parseDouble(const char*& p, const char* end, double& value) {
+	skipBlanks(p, end);
+	const char* start = p;
+	const char* q = p;
+	bool negative = false;
+	if (q != end and (*q == '+' or *q == '-')) {
+		negative = (*q == '-');
+		++q;
+	}
+
+	uint64_t mantissa = 0;
+	int digits = 0;              // Significant digits in the mantissa.
+	int exponent = 0;
+	bool exact = true;           // "false" if some significant digit did not fit in the mantissa.
+	bool anyDigit = false;
+	for (; q != end and isDigit(*q); ++q) {
+		anyDigit = true;
+		if (digits < 19) {
+			mantissa = 10*mantissa + (*q - '0');
+			if (mantissa != 0) ++digits;
+		} else {
+			++exponent;
+			exact = false;
+		}
+	}
+	if (q != end and *q == '.') {
+		++q;
+		for (; q != end and isDigit(*q); ++q) {
+			anyDigit = true;
+			if (digits < 19) {
+				mantissa = 10*mantissa + (*q - '0');
+				if (mantissa != 0) ++digits;
+				--exponent;
+			} else exact = false;
+		}
+	}
+	if (not anyDigit) return false;
+
+	if (q != end and (*q == 'e' or *q == 'E')) {
+		const char* e = q + 1;
+		bool negativeExponent = false;
+		if (e != end and (*e == '+' or *e == '-')) {
+			negativeExponent = (*e == '-');
+			++e;
+		}
+		if (e != end and isDigit(*e)) {
+			int written = 0;
+			for (; e != end and isDigit(*e); ++e) if (written < 100000) written = 10*written + (*e - '0');
+			exponent += negativeExponent ? -written : written;
+			q = e;
+		}
+	}
+	p = q;
+
+	if (exact and mantissa <= (uint64_t(1) << 53) and exponent >= -22 and exponent <= 22) {
+		value = double(mantissa);
+		if (exponent >= 0) value *= powersOfTen[exponent];
+		else value /= powersOfTen[-exponent];
+		if (negative) value = -value;
+		return true;
+	}
+	string number(start, q);
+	value = strtod(number.c_str(), nullptr);
+	return true;
+}
@@ -0,0 +1,28 @@
+#ifndef FastParse_hh
+#define FastParse_hh
+#include <cstddef>
+
+/* Locale-free parsing of text held in memory, without streams and without allocating memory.
+Every function receives a cursor "p" and the end of the text, and advances the cursor over what it reads. */
+
+/** Returns "true" if "c" is a white space character (the same ones skipped by the extraction operator of the streams). */
+inline bool isBlank(char c) {
+	return c == ' ' or c == '\t' or c == '\n' or c == '\v' or c == '\f' or c == '\r';
+}
+
+/** Skips the white space characters at the cursor. */
+inline void skipBlanks(const char*& p, const char* end) {
+	while (p != end and isBlank(*p)) ++p;
+}
+
+/** Skips the white space characters at the cursor and reads the next word (a sequence of non-blank characters).
+	Stores in "word" its first character and in "size" its length, which is "0" if there are no more words. */
+void parseWord(const char*& p, const char* end, const char*& word, size_t& size);
+
+/** Skips the white space characters at the cursor and reads a decimal number (with optional sign, decimals and exponent).
+	Returns "false", with the cursor after the white space, if there is no number at the cursor.
+	The result is correctly rounded: the numbers with at most 19 significant digits and small exponents are computed directly,
+	and the others are converted with "strtod". */
+bool parseDouble(const char*& p, const char* end, double& value);
+
+#endif
@@ -0,0 +1,63 @@
+#include "ImageQueue.hh"
+#include <algorithm>
+#include <climits>
+using namespace std;
+
+ImageQueue::ImageQueue() : pending(0) {}
+
+/* The pool does not run the tasks that have not started when it is destroyed, so all of them must have finished before. */
+ImageQueue::~ImageQueue() {
+	waitAll();
+}
+
+/* The job is counted as pending before it is submitted, so waiting for its file right after this call waits for it.
+When it finishes, the threads that wait are woken up. */
+void ImageQueue::submit(long order, const string& nameFile, function<bool()> job) {
+	waitFile(nameFile);
+	{
+		lock_guard<mutex> guard(lock);
+		if (pool == nullptr) pool.reset(new TaskPool(hardwareThreads()));
+		++pending;
+		++pendingFiles[nameFile];
+	}
+	pool->submit([this, order, nameFile, job] {
+		bool written = job();
+		lock_guard<mutex> guard(lock);
+		if (not written) failures.push_back({order, nameFile});
+		if (--pendingFiles[nameFile] == 0) pendingFiles.erase(nameFile);
+		--pending;
+		finished.notify_all();
+	});
+}
+
+bool ImageQueue::idle() const {
+	lock_guard<mutex> guard(lock);
+	return pending == 0;
+}
+
+void ImageQueue::waitFile(const string& nameFile) {
+	unique_lock<mutex> guard(lock);
+	finished.wait(guard, [&] { return pendingFiles.count(nameFile) == 0; });
+}
+
+void ImageQueue::waitAll() {
+	unique_lock<mutex> guard(lock);
+	finished.wait(guard, [this] { return pending == 0; });
+}
+
+void ImageQueue::collect(vector<string>& failed) {
+	collect(LONG_MIN, LONG_MAX, failed);
+}
+
+/* The failures of the range are moved to the end of the vector. The sort is stable, so the images with the same order keep the order in which they failed. */
+void ImageQueue::collect(long first, long last, vector<string>& failed) {
+	unique_lock<mutex> guard(lock);
+	finished.wait(guard, [this] { return pending == 0; });
+	auto end = stable_partition(failures.begin(), failures.end(), [=](const pair<long, string>& failure) {
+		return failure.first < first or failure.first >= last;
+	});
+	stable_sort(end, failures.end(), [](const pair<long, string>& a, const pair<long, string>& b) { return a.first < b.first; });
+	failed.clear();
+	for (auto it = end; it != failures.end(); ++it) failed.push_back(it->second);
+	failures.erase(end, failures.end());
+}
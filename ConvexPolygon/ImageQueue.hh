@@ -0,0 +1,56 @@
+#ifndef ImageQueue_hh
+#define ImageQueue_hh
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include "Parallel.hh"
+using namespace std;
+
+/* The ImageQueue class draws images in the background, so that the commands that draw them do not wait until the image is rasterized, encoded
+and written. Every image is a job that owns a copy of what it draws, and the jobs run on a pool of threads that is started with the first image.
+The images written to the same file are written one after another, in the order in which they are added.
+The files that cannot be written are kept with the order given with their job, and are reported sorted by it, so the errors do not depend
+on which job finishes first. */
+
+class ImageQueue {
+
+public:
+	/** Constructor. No thread is started until the first image is added. */
+	ImageQueue();
+
+	/** Destructor. Waits for the images that are pending. */
+	~ImageQueue();
+
+	/** Adds a job that writes the file "nameFile", returning "false" if it cannot be written. If an image of the same file is pending,
+		it waits for it first. "order" tells where the error of the job goes among the others. */
+	void submit(long order, const string& nameFile, function<bool()> job);
+
+	/** Returns "true" if no image is pending. */
+	bool idle() const;
+
+	/** Waits until no image of the given file is pending. */
+	void waitFile(const string& nameFile);
+
+	/** Waits until no image is pending. */
+	void waitAll();
+
+	/** Waits until no image is pending, and stores in "failed" the files that could not be written since the last call, sorted by their order. */
+	void collect(vector<string>& failed);
+
+	/** Like "collect", but only for the files whose order is in [first, last): the other ones are kept for their own calls. */
+	void collect(long first, long last, vector<string>& failed);
+
+private:
+	mutable mutex lock;
+	condition_variable finished;
+	unique_ptr<TaskPool> pool;
+	int pending;                            // Images that have not finished,
+	map<string, int> pendingFiles;          // by file.
+	vector<pair<long, string>> failures;    // Order and file of the images that could not be written.
+};
+
+#endif
@@ -0,0 +1,313 @@
+#include "Journal.hh"
+#include "PolygonStore.hh"
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std;
+
+static const char magic[8] = {'C', 'V', 'X', 'J', 'R', 'N', 'L', 0};
+static const uint32_t version = 1;
+static const uint64_t headerSize = 16;
+static const uint64_t frameSize = 16;
+
+const size_t Journal::groupBytes;
+const uint64_t Journal::minSnapshotBytes;
+
+/* The records are written as they are in memory, so the format can only be used by little-endian machines. */
+static bool isLittleEndian() {
+	uint16_t one = 1;
+	unsigned char first;
+	memcpy(&first, &one, 1);
+	return first == 1;
+}
+
+/* Returns the given size rounded up to a multiple of 8. */
+static uint64_t align8(uint64_t size) {
+	return (size + 7)/8*8;
+}
+
+/* Writes "value" in "buffer" at the given position. */
+template <typename T>
+static void put(vector<char>& buffer, size_t position, T value) {
+	memcpy(buffer.data() + position, &value, sizeof(T));
+}
+
+/* Reads a value of type T from "base" at the given position. */
+template <typename T>
+static T get(const char* base, uint64_t position) {
+	T value;
+	memcpy(&value, base + position, sizeof(T));
+	return value;
+}
+
+/* FNV-1a over words of 64 bits instead of bytes (the data is a multiple of 8 bytes), starting from the type and the size,
+so a record whose data moved to another type or size does not match. */
+static uint64_t checksum(uint32_t type, uint32_t size, const char* data) {
+	uint64_t h = 14695981039346656037ull ^ (uint64_t(type) << 32 | size);
+	for (uint32_t i = 0; i < size; i += 8) h = (h ^ get<uint64_t>(data, i))*1099511628211ull;
+	return h;
+}
+
+/* Appends to "buffer" the frame of a record of the given type, with room for "size" bytes of data (filled with zeros),
+and returns the position of the frame. */
+static size_t beginRecord(vector<char>& buffer, JournalRecord type, uint32_t size) {
+	size_t frame = buffer.size();
+	buffer.resize(frame + frameSize + size, 0);
+	put<uint32_t>(buffer, frame, size);
+	put<uint32_t>(buffer, frame + 4, type);
+	return frame;
+}
+
+/* Fills the checksum of the record whose frame is at the given position, once its data has been written. */
+static void endRecord(vector<char>& buffer, size_t frame) {
+	uint32_t size = get<uint32_t>(buffer.data(), frame);
+	uint32_t type = get<uint32_t>(buffer.data(), frame + 4);
+	put<uint64_t>(buffer, frame + 8, checksum(type, size, buffer.data() + frame + frameSize));
+}
+
+static void appendPolygon(vector<char>& buffer, const string& identifier, const VertexArray& vertices) {
+	uint64_t nameSize = align8(identifier.size());
+	size_t n = vertices.size();
+	size_t frame = beginRecord(buffer, JournalPolygon, 8 + nameSize + 2*n*sizeof(double));
+	size_t data = frame + frameSize;
+	put<uint32_t>(buffer, data, identifier.size());
+	put<uint32_t>(buffer, data + 4, n);
+	memcpy(buffer.data() + data + 8, identifier.data(), identifier.size());
+	memcpy(buffer.data() + data + 8 + nameSize, vertices.xs(), n*sizeof(double));
+	memcpy(buffer.data() + data + 8 + nameSize + n*sizeof(double), vertices.ys(), n*sizeof(double));
+	endRecord(buffer, frame);
+}
+
+static void appendColor(vector<char>& buffer, const string& identifier, const unsigned char rgba[4]) {
+	size_t frame = beginRecord(buffer, JournalColor, 8 + align8(identifier.size()));
+	size_t data = frame + frameSize;
+	put<uint32_t>(buffer, data, identifier.size());
+	memcpy(buffer.data() + data + 4, rgba, 4);
+	memcpy(buffer.data() + data + 8, identifier.data(), identifier.size());
+	endRecord(buffer, frame);
+}
+
+/* "write" may write less bytes than asked (or be interrupted), so it is called until all of them have been written. */
+static bool writeFully(int fd, const char* data, size_t size) {
+	while (size > 0) {
+		ssize_t written = write(fd, data, size);
+		if (written < 0 and errno == EINTR) continue;
+		if (written <= 0) return false;
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+
+/* The rename of a file is only durable once its directory has been synchronized. */
+static bool syncDirectory(const string& nameFile) {
+	size_t slash = nameFile.rfind('/');
+	string directory = slash == string::npos ? "." : (slash == 0 ? "/" : nameFile.substr(0, slash));
+	int dir = open(directory.c_str(), O_RDONLY);
+	if (dir < 0) return false;
+	bool synced = fsync(dir) == 0;
+	close(dir);
+	return synced;
+}
+
+/* Implementation of the class Journal */
+
+Journal::Journal() : fd(-1), fileSize(0), syncedSize(0), snapshotBytes(0), recordBytes(0), failed(false) {}
+
+Journal::~Journal() {
+	if (fd < 0) return;
+	flush();
+	close(fd);
+}
+
+/* A new journal (or one whose header was not completely written) gets its header, which is synchronized before any record is added.
+Otherwise, the records are replayed and the part of the file after the valid records is cut, so the next records follow the valid ones. */
+bool Journal::open(const string& name, PolygonStore& store) {
+	if (not isLittleEndian()) return false;
+	int file = ::open(name.c_str(), O_RDWR | O_CREAT, 0644);
+	if (file < 0) return false;
+	struct stat info;
+	if (fstat(file, &info) != 0 or not S_ISREG(info.st_mode)) {
+		close(file);
+		return false;
+	}
+	fd = file;
+	nameFile = name;
+	uint64_t size = info.st_size;
+	char header[headerSize] = {0};
+	memcpy(header, magic, 8);
+	memcpy(header + 8, &version, 4);
+	if (size < headerSize) {
+		vector<char> start(size);
+		if (pread(fd, start.data(), size, 0) != ssize_t(size) or memcmp(start.data(), header, size) != 0 or ftruncate(fd, 0) != 0
+		    or not writeFully(fd, header, headerSize) or fdatasync(fd) != 0) {
+			close(fd);
+			fd = -1;
+			return false;
+		}
+		size = headerSize;
+		snapshotBytes = headerSize;
+	} else {
+		uint64_t valid = replay(size, store);
+		if (valid == 0 or (valid < size and ftruncate(fd, valid) != 0)) {
+			close(fd);
+			fd = -1;
+			return false;
+		}
+		size = valid;
+	}
+	lseek(fd, size, SEEK_SET);
+	fileSize = syncedSize = size;
+	recordBytes = fileSize - snapshotBytes;
+	return true;
+}
+
+/* The file is mapped and read once. The records stop at the first one that does not fit in the file, has a wrong checksum or has data that
+does not match its type. Small polygons get their vertices inside the polygon, and the other ones are copied by the store into its arena,
+so the mapping is released at the end. Returns "0" if the file is not a journal. */
+uint64_t Journal::replay(uint64_t size, PolygonStore& store) {
+	void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (address == MAP_FAILED) return 0;
+	shared_ptr<const void> mapping(address, [size](const void* a) { munmap(const_cast<void*>(a), size); });
+	const char* base = (const char*)address;
+	if (memcmp(base, magic, 8) != 0 or get<uint32_t>(base, 8) != version) return 0;
+	madvise(address, size, MADV_SEQUENTIAL);
+
+	snapshotBytes = headerSize;
+	uint64_t position = headerSize;
+	vector<Point> points;
+	vector<Handle> restored;
+	while (size - position >= frameSize) {
+		uint32_t dataSize = get<uint32_t>(base, position);
+		uint32_t type = get<uint32_t>(base, position + 4);
+		const char* data = base + position + frameSize;
+		if (dataSize % 8 != 0 or dataSize > size - position - frameSize) break;
+		if (get<uint64_t>(base, position + 8) != checksum(type, dataSize, data)) break;
+		if (type == JournalPolygon) {
+			if (dataSize < 8) break;
+			uint64_t nameSize = get<uint32_t>(data, 0);
+			uint64_t n = get<uint32_t>(data, 4);
+			if (8 + align8(nameSize) + 2*n*sizeof(double) != dataSize) break;
+			const double* xs = (const double*)(data + 8 + align8(nameSize));
+			const double* ys = xs + n;
+			VertexArray vertices;
+			if (n <= VertexArray::inlineCapacity) {
+				points.clear();
+				for (uint64_t i = 0; i < n; ++i) points.push_back(Point(xs[i], ys[i]));
+				vertices = VertexArray(points);
+			} else vertices = VertexArray(xs, ys, n, mapping);
+			store.setPolygon(store.intern(string(data + 8, nameSize)), ConvexPolygon::fromHull(vertices));
+		} else if (type == JournalColor) {
+			if (dataSize < 8 or 8 + align8(get<uint32_t>(data, 0)) != dataSize) break;
+			store.setColor(store.intern(string(data + 8, get<uint32_t>(data, 0))), (const unsigned char*)data + 4);
+		} else if (type == JournalCheckpoint and dataSize == 0) store.checkpoint();
+		else if (type == JournalRollback and dataSize == 0) store.rollback(restored);
+		else if (type == JournalCommit and dataSize == 0) store.commit();
+		else if (type == JournalSnapshot and dataSize == 0) snapshotBytes = position + frameSize;
+		else break;
+		position += frameSize + dataSize;
+	}
+	return position;
+}
+
+void Journal::recordPolygon(const string& identifier, const VertexArray& vertices) {
+	lock_guard<mutex> guard(lock);
+	size_t before = pending.size();
+	appendPolygon(pending, identifier, vertices);
+	recordBytes += pending.size() - before;
+	if (pending.size() >= groupBytes) writePending();
+}
+
+void Journal::recordColor(const string& identifier, const unsigned char rgba[4]) {
+	lock_guard<mutex> guard(lock);
+	size_t before = pending.size();
+	appendColor(pending, identifier, rgba);
+	recordBytes += pending.size() - before;
+	if (pending.size() >= groupBytes) writePending();
+}
+
+void Journal::recordMark(JournalRecord type) {
+	lock_guard<mutex> guard(lock);
+	endRecord(pending, beginRecord(pending, type, 0));
+	recordBytes += frameSize;
+}
+
+void Journal::writePending() {
+	if (pending.empty()) return;
+	if (writeFully(fd, pending.data(), pending.size())) fileSize += pending.size();
+	else {
+		failed = true;
+		recordBytes -= pending.size();
+		if (ftruncate(fd, fileSize) == 0) lseek(fd, fileSize, SEEK_SET);
+	}
+	pending.clear();
+}
+
+/* The file is only synchronized if it has grown since the last time, so the calls that find their records already synchronized by another
+thread (or that have no records) do not wait for the disk. */
+bool Journal::flush() {
+	if (fd < 0) return true;
+	lock_guard<mutex> guard(lock);
+	writePending();
+	if (fileSize != syncedSize) {
+		if (fdatasync(fd) != 0) failed = true;
+		syncedSize = fileSize;
+	}
+	bool written = not failed;
+	failed = false;
+	return written;
+}
+
+bool Journal::needsSnapshot(const PolygonStore& store) {
+	if (fd < 0 or store.checkpoints() > 0) return false;
+	lock_guard<mutex> guard(lock);
+	return recordBytes > max(minSnapshotBytes, snapshotBytes);
+}
+
+bool Journal::snapshotIfNeeded(const PolygonStore& store) {
+	return not needsSnapshot(store) or snapshot(store);
+}
+
+/* The snapshot is written to a temporary file in groups of records, and it only replaces the journal once it is completely on disk.
+The file stays open after the rename, and the next records are appended to it. The pending records are already in the store,
+so they are discarded when it replaces the journal. */
+bool Journal::snapshot(const PolygonStore& store) {
+	if (fd < 0 or store.checkpoints() > 0) return false;
+	lock_guard<mutex> guard(lock);
+	string temporary = nameFile + ".tmp";
+	int file = ::open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (file < 0) return false;
+	vector<char> buffer(headerSize, 0);
+	memcpy(buffer.data(), magic, 8);
+	put<uint32_t>(buffer, 8, version);
+	uint64_t size = 0;
+	bool written = true;
+	for (Handle h = 0; h < store.size() and written; ++h) {
+		if (not store.defined(h)) continue;
+		appendPolygon(buffer, store.name(h), store.polygon(h).getPoints());
+		appendColor(buffer, store.name(h), store.color(h));
+		if (buffer.size() >= groupBytes) {
+			written = writeFully(file, buffer.data(), buffer.size());
+			size += buffer.size();
+			buffer.clear();
+		}
+	}
+	endRecord(buffer, beginRecord(buffer, JournalSnapshot, 0));
+	written = written and writeFully(file, buffer.data(), buffer.size()) and fdatasync(file) == 0;
+	size += buffer.size();
+	if (not written or rename(temporary.c_str(), nameFile.c_str()) != 0) {
+		close(file);
+		unlink(temporary.c_str());
+		return false;
+	}
+	syncDirectory(nameFile);
+	close(fd);
+	fd = file;
+	fileSize = syncedSize = snapshotBytes = size;
+	recordBytes = 0;
+	pending.clear();
+	return true;
+}
@@ -0,0 +1,97 @@
+#ifndef Journal_hh
+#define Journal_hh
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include "VertexArray.hh"
+using namespace std;
+
+class PolygonStore;
+
+/* Write-ahead journal of a PolygonStore, so that its polygons survive the end of the calculator or a crash. The store records in the journal
+every change of a polygon (with its new vertices) or of a color, and the checkpoints, rollbacks and commits, and the journal appends them
+to a file. When the calculator starts again, the store is restored by replaying the file.
+The records are kept in memory and written in groups: "flush" writes all the pending records and waits until they are on disk with a single
+synchronization (group commit), so the changes of many commands cost one synchronization. Big groups are written before the flush.
+When the records take more space than the last snapshot, the whole file is replaced by a snapshot: a record for every polygon and color of the store,
+written to a new file that is renamed over the journal, so the file never stops being valid. The replay starts from that snapshot.
+The format is little-endian, with every record at a multiple of 8 bytes:
+	- Header: the magic string "CVXJRNL" followed by a zero byte, the version (32 bits) and 4 zero bytes.
+	- Records: the size of the data (32 bits, a multiple of 8), the type (32 bits), a checksum of the type and the data (64 bits), and the data.
+	  A polygon record has the length of the identifier and the number of vertices (32 bits each), the identifier (padded with zeros
+	  to a multiple of 8 bytes), and the X and then the Y coordinates of the vertices (64-bit doubles). A color record has the length
+	  of the identifier (32 bits), the red, green, blue and alpha values (a byte each) and the padded identifier. The other records have no data.
+A record that is incomplete or has a wrong checksum is the end of a write interrupted by a crash: it and everything after it are discarded. */
+
+/** Types of the records of a journal. */
+enum JournalRecord { JournalPolygon = 1, JournalColor, JournalCheckpoint, JournalRollback, JournalCommit, JournalSnapshot };
+
+class Journal {
+
+public:
+	/** Constructor. The journal is not open. */
+	Journal();
+
+	/** Destructor. Writes the pending records and closes the file. */
+	~Journal();
+
+	/** Opens the journal "nameFile", creating it if it does not exist, and replays its records into "store", which must be empty
+		and must not have a journal yet. Returns "false" if the file cannot be opened or created, or it is not a journal. */
+	bool open(const string& nameFile, PolygonStore& store);
+
+	/** Returns "true" if the journal is open. */
+	bool isOpen() const { return fd >= 0; }
+
+	/** Returns the name of the file of the journal. */
+	const string& name() const { return nameFile; }
+
+	/** Records that the polygon of an identifier has now the given vertices. Can be called from several threads. */
+	void recordPolygon(const string& identifier, const VertexArray& vertices);
+
+	/** Records that the color of an identifier has changed. Can be called from several threads. */
+	void recordColor(const string& identifier, const unsigned char rgba[4]);
+
+	/** Records a checkpoint, a rollback or a commit of the store. */
+	void recordMark(JournalRecord type);
+
+	/** Writes the pending records and waits until they are on disk. Returns "false" if some record could not be written since the last call
+		(the records that could not be written are lost). */
+	bool flush();
+
+	/** Returns "true" if the records written since the last snapshot take more space than it (and more than "minSnapshotBytes"),
+		and "store" has no checkpoints. */
+	bool needsSnapshot(const PolygonStore& store);
+
+	/** Replaces the journal by a snapshot of "store" if the records written since the last snapshot take more space than it
+		(and more than "minSnapshotBytes"). Returns "false" if the snapshot had to be written and it could not be. */
+	bool snapshotIfNeeded(const PolygonStore& store);
+
+	/** Replaces the journal by a snapshot of "store", which includes the pending records. The store must not have checkpoints,
+		since the versions that they saved would be lost. Returns "false" if it cannot be written (then, the journal does not change). */
+	bool snapshot(const PolygonStore& store);
+
+	/** Bytes of pending records that are written before the next flush, and smallest size of the records that causes a snapshot. */
+	static const size_t groupBytes = 1 << 20;
+	static const uint64_t minSnapshotBytes = 1 << 22;
+
+private:
+	string nameFile;
+	int fd;
+	mutex lock;
+	vector<char> pending;             // Records that have not been written.
+	uint64_t fileSize;                // Bytes of the file, all of them valid,
+	uint64_t syncedSize;              // and the ones known to be on disk.
+	uint64_t snapshotBytes;           // Bytes of the last snapshot (or of the header, if there is none),
+	uint64_t recordBytes;             // and of the records added after it, including the pending ones.
+	bool failed;                      // "true" if some record could not be written since the last flush.
+
+	/** Writes the pending records to the file, holding "lock". If they cannot be written, they are discarded and the file is cut back
+		to its last valid size. */
+	void writePending();
+
+	/** Replays the records of the file, whose first "size" bytes are valid, into "store". Returns the size of the valid part. */
+	uint64_t replay(uint64_t size, PolygonStore& store);
+};
+
+#endif
@@ -0,0 +1,326 @@
+#include "Kernels.hh"
+#include <cmath>
+#include <algorithm>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define X86_KERNELS
+#endif
+using namespace std;
+
+/* The first edge ('n-1 0') and the vertices that do not fill a whole vector are added one by one with the scalar formulas. 
+The limits are updated like the "min" and "max" instructions of the vectors do (keeping the second value unless the first one is strictly farther),
+so all the levels give the same sign to a zero limit. */
+static inline void addEdge(const double* x, const double* y, int i, int j, PolygonSums& sums) {
+	double xi = x[i], yi = y[i];
+	double xj = x[j], yj = y[j];
+	sums.area += (xj + xi) * (yj - yi);
+	double dx = xj - xi;
+	double dy = yj - yi;
+	sums.perimeter += sqrt(dx*dx + dy*dy);
+	sums.cX += (xi + xj) * (xi*yj - xj*yi);
+	sums.cY += (yi + yj) * (xi*yj - xj*yi);
+	sums.xmin = (sums.xmin < xi) ? sums.xmin : xi;
+	sums.xmax = (sums.xmax > xi) ? sums.xmax : xi;
+	sums.ymin = (sums.ymin < yi) ? sums.ymin : yi;
+	sums.ymax = (sums.ymax > yi) ? sums.ymax : yi;
+}
+
+/* Initializes the sums with the first edge, and returns "false" if there are no vertices. */
+static bool startSums(const double* x, const double* y, int size, PolygonSums& sums) {
+	sums.area = sums.perimeter = sums.cX = sums.cY = 0;
+	if (size == 0) {
+		sums.xmin = sums.xmax = sums.ymin = sums.ymax = 0;
+		return false;
+	}
+	sums.xmin = sums.xmax = x[0];
+	sums.ymin = sums.ymax = y[0];
+	addEdge(x, y, 0, size - 1, sums);
+	return true;
+}
+
+/* All the levels add the edges from the second vertex on in four lanes, the edge ending at vertex i going to lane (i - 1) % 4, and combine the lanes
+in the same order, so that the results do not depend on the level (floating point additions are not associative). The values of the lanes
+are in "lanes", four by four: area, perimeter, cX, cY, xmin, xmax, ymin and ymax. */
+static void addLanes(const double lanes[32], PolygonSums& sums) {
+	const double* l = lanes;
+	sums.area += (l[0] + l[2]) + (l[1] + l[3]);
+	sums.perimeter += (l[4] + l[6]) + (l[5] + l[7]);
+	sums.cX += (l[8] + l[10]) + (l[9] + l[11]);
+	sums.cY += (l[12] + l[14]) + (l[13] + l[15]);
+	sums.xmin = min(min(l[16], l[17]), min(l[18], l[19]));
+	sums.xmax = max(max(l[20], l[21]), max(l[22], l[23]));
+	sums.ymin = min(min(l[24], l[25]), min(l[26], l[27]));
+	sums.ymax = max(max(l[28], l[29]), max(l[30], l[31]));
+}
+
+/* The scalar version keeps the four lanes in separate sums, like the vector versions. */
+static void scalarSums(const double* x, const double* y, int size, PolygonSums& sums) {
+	if (not startSums(x, y, size, sums)) return;
+	PolygonSums lane[4];
+	for (int l = 0; l < 4; ++l) {
+		lane[l].area = lane[l].perimeter = lane[l].cX = lane[l].cY = 0;
+		lane[l].xmin = lane[l].xmax = sums.xmin;
+		lane[l].ymin = lane[l].ymax = sums.ymin;
+	}
+	int i = 1;
+	for (; i + 4 <= size; i += 4) {
+		for (int l = 0; l < 4; ++l) addEdge(x, y, i + l, i + l - 1, lane[l]);
+	}
+	double lanes[32];
+	for (int l = 0; l < 4; ++l) {
+		lanes[l] = lane[l].area;
+		lanes[4 + l] = lane[l].perimeter;
+		lanes[8 + l] = lane[l].cX;
+		lanes[12 + l] = lane[l].cY;
+		lanes[16 + l] = lane[l].xmin;
+		lanes[20 + l] = lane[l].xmax;
+		lanes[24 + l] = lane[l].ymin;
+		lanes[28 + l] = lane[l].ymax;
+	}
+	addLanes(lanes, sums);
+	for (; i < size; ++i) addEdge(x, y, i, i - 1, sums);
+}
+
+/* Projections of a point on the directions of "ExtremePoints": the maximum of each one gives the first four directions, and the minimum the other four. */
+static inline void projections(double x, double y, double v[4]) {
+	v[0] = x;
+	v[1] = x + y;
+	v[2] = y;
+	v[3] = y - x;
+}
+
+/* Updates the extremes, whose projections are in "high" and "low", with the points in [first, size). A point only replaces another one 
+if it goes strictly farther, so the first point is kept in case of a tie. */
+static void addExtremes(const double* xy, int first, int size, double high[4], double low[4], ExtremePoints& extremes) {
+	for (int i = first; i < size; ++i) {
+		double v[4];
+		projections(xy[2*i], xy[2*i + 1], v);
+		for (int k = 0; k < 4; ++k) {
+			if (v[k] > high[k]) {
+				high[k] = v[k];
+				extremes.position[k] = i;
+			}
+			if (v[k] < low[k]) {
+				low[k] = v[k];
+				extremes.position[k + 4] = i;
+			}
+		}
+	}
+}
+
+/* Every extreme starts at the first point. */
+static void startExtremes(const double* xy, double high[4], double low[4], ExtremePoints& extremes) {
+	projections(xy[0], xy[1], high);
+	projections(xy[0], xy[1], low);
+	for (int k = 0; k < 8; ++k) extremes.position[k] = 0;
+}
+
+/* Given the values and positions of the extremes found by the lanes of a vector (every lane keeps the first point of its own ones), 
+it stores in "value" and "position" the extreme of all of them: the lowest position among the lanes with the farthest value. */
+static void reduceLanes(const double* values, const double* positions, int lanes, bool highest, double& value, int& position) {
+	value = values[0];
+	double at = positions[0];
+	for (int l = 1; l < lanes; ++l) {
+		if ((highest ? values[l] > value : values[l] < value) or (values[l] == value and positions[l] < at)) {
+			value = values[l];
+			at = positions[l];
+		}
+	}
+	position = int(at);
+}
+
+static void scalarExtremes(const double* xy, int size, ExtremePoints& extremes) {
+	double high[4], low[4];
+	startExtremes(xy, high, low, extremes);
+	addExtremes(xy, 1, size, high, low, extremes);
+}
+
+#ifdef X86_KERNELS
+
+/* Adds an edge of a lane (from "xj", "yj" to "xi", "yi") to the sums of the lanes of two vectors. */
+static inline void addEdges(__m128d xi, __m128d yi, __m128d xj, __m128d yj, __m128d acc[8]) {
+	__m128d dx = _mm_sub_pd(xj, xi), dy = _mm_sub_pd(yj, yi);
+	acc[0] = _mm_add_pd(acc[0], _mm_mul_pd(_mm_add_pd(xj, xi), dy));
+	acc[1] = _mm_add_pd(acc[1], _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy))));
+	__m128d c = _mm_sub_pd(_mm_mul_pd(xi, yj), _mm_mul_pd(xj, yi));
+	acc[2] = _mm_add_pd(acc[2], _mm_mul_pd(_mm_add_pd(xi, xj), c));
+	acc[3] = _mm_add_pd(acc[3], _mm_mul_pd(_mm_add_pd(yi, yj), c));
+	acc[4] = _mm_min_pd(acc[4], xi);
+	acc[5] = _mm_max_pd(acc[5], xi);
+	acc[6] = _mm_min_pd(acc[6], yi);
+	acc[7] = _mm_max_pd(acc[7], yi);
+}
+
+/* Every iteration handles the edges ending at vertices i to i + 3: the vertices before them are loaded from position i - 1. 
+The four lanes are kept in two vectors, "low" with the lanes 0 and 1 and "high" with the lanes 2 and 3. */
+static void sseSums(const double* x, const double* y, int size, PolygonSums& sums) {
+	if (not startSums(x, y, size, sums)) return;
+	__m128d low[8], high[8];
+	for (int k = 0; k < 4; ++k) low[k] = high[k] = _mm_setzero_pd();
+	low[4] = low[5] = high[4] = high[5] = _mm_set1_pd(sums.xmin);
+	low[6] = low[7] = high[6] = high[7] = _mm_set1_pd(sums.ymin);
+	int i = 1;
+	for (; i + 4 <= size; i += 4) {
+		addEdges(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i), _mm_loadu_pd(x + i - 1), _mm_loadu_pd(y + i - 1), low);
+		addEdges(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2), _mm_loadu_pd(x + i + 1), _mm_loadu_pd(y + i + 1), high);
+	}
+	double lanes[32];
+	for (int k = 0; k < 8; ++k) {
+		_mm_storeu_pd(lanes + 4*k, low[k]);
+		_mm_storeu_pd(lanes + 4*k + 2, high[k]);
+	}
+	addLanes(lanes, sums);
+	for (; i < size; ++i) addEdge(x, y, i, i - 1, sums);
+}
+
+/* Returns "b" in the lanes where "mask" is set and "a" in the others. */
+static inline __m128d select(__m128d mask, __m128d a, __m128d b) {
+	return _mm_or_pd(_mm_and_pd(mask, b), _mm_andnot_pd(mask, a));
+}
+
+/* Every lane keeps the extremes of the points in its own positions, as doubles (they are exact up to 2^53). Every iteration loads two points
+and splits their interleaved coordinates in a vector of X coordinates and a vector of Y coordinates. All the lanes start at the first point. */
+static void sseExtremes(const double* xy, int size, ExtremePoints& extremes) {
+	double high[4], low[4];
+	startExtremes(xy, high, low, extremes);
+	__m128d highest[4], lowest[4], highAt[4], lowAt[4];
+	for (int k = 0; k < 4; ++k) {
+		highest[k] = _mm_set1_pd(high[k]);
+		lowest[k] = _mm_set1_pd(low[k]);
+		highAt[k] = lowAt[k] = _mm_setzero_pd();
+	}
+	__m128d at = _mm_setr_pd(0, 1);
+	const __m128d step = _mm_set1_pd(2);
+	int i = 0;
+	for (; i + 2 <= size; i += 2) {
+		__m128d a = _mm_loadu_pd(xy + 2*i), b = _mm_loadu_pd(xy + 2*i + 2);
+		__m128d x = _mm_unpacklo_pd(a, b), y = _mm_unpackhi_pd(a, b);
+		__m128d v[4] = {x, _mm_add_pd(x, y), y, _mm_sub_pd(y, x)};
+		for (int k = 0; k < 4; ++k) {
+			__m128d farther = _mm_cmpgt_pd(v[k], highest[k]);
+			highest[k] = select(farther, highest[k], v[k]);
+			highAt[k] = select(farther, highAt[k], at);
+			farther = _mm_cmplt_pd(v[k], lowest[k]);
+			lowest[k] = select(farther, lowest[k], v[k]);
+			lowAt[k] = select(farther, lowAt[k], at);
+		}
+		at = _mm_add_pd(at, step);
+	}
+	double values[2], positions[2];
+	for (int k = 0; k < 4; ++k) {
+		_mm_storeu_pd(values, highest[k]);
+		_mm_storeu_pd(positions, highAt[k]);
+		reduceLanes(values, positions, 2, true, high[k], extremes.position[k]);
+		_mm_storeu_pd(values, lowest[k]);
+		_mm_storeu_pd(positions, lowAt[k]);
+		reduceLanes(values, positions, 2, false, low[k], extremes.position[k + 4]);
+	}
+	addExtremes(xy, i, size, high, low, extremes);
+}
+
+/* The same as "sseSums", with the four lanes in a single vector. */
+__attribute__((target("avx2")))
+static void avx2Sums(const double* x, const double* y, int size, PolygonSums& sums) {
+	if (not startSums(x, y, size, sums)) return;
+	__m256d area = _mm256_setzero_pd(), perimeter = _mm256_setzero_pd(), cX = _mm256_setzero_pd(), cY = _mm256_setzero_pd();
+	__m256d xmin = _mm256_set1_pd(sums.xmin), xmax = xmin, ymin = _mm256_set1_pd(sums.ymin), ymax = ymin;
+	int i = 1;
+	for (; i + 4 <= size; i += 4) {
+		__m256d xi = _mm256_loadu_pd(x + i), yi = _mm256_loadu_pd(y + i);
+		__m256d xj = _mm256_loadu_pd(x + i - 1), yj = _mm256_loadu_pd(y + i - 1);
+		__m256d dx = _mm256_sub_pd(xj, xi), dy = _mm256_sub_pd(yj, yi);
+		area = _mm256_add_pd(area, _mm256_mul_pd(_mm256_add_pd(xj, xi), dy));
+		perimeter = _mm256_add_pd(perimeter, _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy))));
+		__m256d c = _mm256_sub_pd(_mm256_mul_pd(xi, yj), _mm256_mul_pd(xj, yi));
+		cX = _mm256_add_pd(cX, _mm256_mul_pd(_mm256_add_pd(xi, xj), c));
+		cY = _mm256_add_pd(cY, _mm256_mul_pd(_mm256_add_pd(yi, yj), c));
+		xmin = _mm256_min_pd(xmin, xi);
+		xmax = _mm256_max_pd(xmax, xi);
+		ymin = _mm256_min_pd(ymin, yi);
+		ymax = _mm256_max_pd(ymax, yi);
+	}
+	double lanes[32];
+	__m256d vectors[8] = {area, perimeter, cX, cY, xmin, xmax, ymin, ymax};
+	for (int k = 0; k < 8; ++k) _mm256_storeu_pd(lanes + 4*k, vectors[k]);
+	addLanes(lanes, sums);
+	for (; i < size; ++i) addEdge(x, y, i, i - 1, sums);
+}
+
+/* The same as "sseExtremes", with four points per iteration. The coordinates are split inside each half of the vectors, 
+so the lanes hold the points i, i + 2, i + 1 and i + 3. */
+__attribute__((target("avx2")))
+static void avx2Extremes(const double* xy, int size, ExtremePoints& extremes) {
+	double high[4], low[4];
+	startExtremes(xy, high, low, extremes);
+	__m256d highest[4], lowest[4], highAt[4], lowAt[4];
+	for (int k = 0; k < 4; ++k) {
+		highest[k] = _mm256_set1_pd(high[k]);
+		lowest[k] = _mm256_set1_pd(low[k]);
+		highAt[k] = lowAt[k] = _mm256_setzero_pd();
+	}
+	__m256d at = _mm256_setr_pd(0, 2, 1, 3);
+	const __m256d step = _mm256_set1_pd(4);
+	int i = 0;
+	for (; i + 4 <= size; i += 4) {
+		__m256d a = _mm256_loadu_pd(xy + 2*i), b = _mm256_loadu_pd(xy + 2*i + 4);
+		__m256d x = _mm256_unpacklo_pd(a, b), y = _mm256_unpackhi_pd(a, b);
+		__m256d v[4] = {x, _mm256_add_pd(x, y), y, _mm256_sub_pd(y, x)};
+		for (int k = 0; k < 4; ++k) {
+			__m256d farther = _mm256_cmp_pd(v[k], highest[k], _CMP_GT_OQ);
+			highest[k] = _mm256_blendv_pd(highest[k], v[k], farther);
+			highAt[k] = _mm256_blendv_pd(highAt[k], at, farther);
+			farther = _mm256_cmp_pd(v[k], lowest[k], _CMP_LT_OQ);
+			lowest[k] = _mm256_blendv_pd(lowest[k], v[k], farther);
+			lowAt[k] = _mm256_blendv_pd(lowAt[k], at, farther);
+		}
+		at = _mm256_add_pd(at, step);
+	}
+	double values[4], positions[4];
+	for (int k = 0; k < 4; ++k) {
+		_mm256_storeu_pd(values, highest[k]);
+		_mm256_storeu_pd(positions, highAt[k]);
+		reduceLanes(values, positions, 4, true, high[k], extremes.position[k]);
+		_mm256_storeu_pd(values, lowest[k]);
+		_mm256_storeu_pd(positions, lowAt[k]);
+		reduceLanes(values, positions, 4, false, low[k], extremes.position[k + 4]);
+	}
+	addExtremes(xy, i, size, high, low, extremes);
+}
+
+#endif
+
+KernelLevel bestKernelLevel() {
+#ifdef X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return AVX2Kernel;
+	if (__builtin_cpu_supports("sse2")) return SSEKernel;
+#endif
+	return ScalarKernel;
+}
+
+/* Level used by the kernels. It is chosen before "main" starts. */
+static KernelLevel currentLevel = bestKernelLevel();
+
+KernelLevel kernelLevel() {
+	return currentLevel;
+}
+
+void setKernelLevel(KernelLevel level) {
+	currentLevel = min(level, bestKernelLevel());
+}
+
+void polygonSums(const double* x, const double* y, int size, PolygonSums& sums) {
+#ifdef X86_KERNELS
+	if (currentLevel == AVX2Kernel) return avx2Sums(x, y, size, sums);
+	if (currentLevel == SSEKernel) return sseSums(x, y, size, sums);
+#endif
+	scalarSums(x, y, size, sums);
+}
+
+void extremePoints(const double* xy, int size, ExtremePoints& extremes) {
+#ifdef X86_KERNELS
+	if (currentLevel == AVX2Kernel) return avx2Extremes(xy, size, extremes);
+	if (currentLevel == SSEKernel) return sseExtremes(xy, size, extremes);
+#endif
+	scalarExtremes(xy, size, extremes);
+}
@@ -0,0 +1,44 @@
+#ifndef Kernels_hh
+#define Kernels_hh
+
+/* Vectorized reductions over the vertices of a polygon, stored as separate arrays of X and Y coordinates, and over sets of points.
+Every reduction has a scalar version and, on x86 processors, SSE2 and AVX2 versions, which give exactly the same results: all of them add
+the terms in the same order (the scalar and SSE2 versions keep the four lanes of the AVX2 one), so the output does not depend on the processor.
+The best version supported by the processor is chosen the first time it is needed. */
+
+/** Instruction sets that the kernels can use. */
+enum KernelLevel { ScalarKernel, SSEKernel, AVX2Kernel };
+
+/** Sums over the edges 'j i' of a polygon (where j is the vertex before i), together with the limits of its vertices. */
+struct PolygonSums {
+	double area;                      // Sum of (X_j + X_i)*(Y_j - Y_i): twice the signed area.
+	double perimeter;                 // Sum of the lengths of the edges.
+	double cX, cY;                    // Sums of (X_i + X_j)*(X_i*Y_j - X_j*Y_i) and (Y_i + Y_j)*(X_i*Y_j - X_j*Y_i).
+	double xmin, xmax, ymin, ymax;    // Limits of the coordinates ("0" for an empty polygon).
+};
+
+/** Positions of the points that go farthest in eight directions, counterclockwise from the right one: right (maximum X), up-right (maximum X + Y),
+	up (maximum Y), up-left (maximum Y - X), left (minimum X), down-left (minimum X + Y), down (minimum Y) and down-right (minimum Y - X).
+	In case of a tie, the first point is given. */
+struct ExtremePoints {
+	int position[8];
+};
+
+/** Returns the best level supported by the processor. */
+KernelLevel bestKernelLevel();
+
+/** Returns the level used by the kernels. */
+KernelLevel kernelLevel();
+
+/** Changes the level used by the kernels. If the processor does not support it, the best supported level is used. */
+void setKernelLevel(KernelLevel level);
+
+/** Computes the sums of the polygon whose "size" vertices have the coordinates stored in "x" and "y". */
+void polygonSums(const double* x, const double* y, int size, PolygonSums& sums);
+
+/** Finds the extreme points of the "size" points whose coordinates are interleaved in "xy" (the X and Y coordinates of the first point, then the ones 
+	of the second point, and so on), in a single pass. Points with a coordinate that is not a number are never chosen, unless they are the first one.
+	Pre: size > 0. */
+void extremePoints(const double* xy, int size, ExtremePoints& extremes);
+
+#endif
@@ -0,0 +1,129 @@
+#include "Output.hh"
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+using namespace std;
+
+/* Size of the buffer. */
+static const size_t bufferSize = 1 << 20;
+
+/* Below this magnitude, the number multiplied by 1000 is smaller than 2^53, so its integer part is exact. */
+static const double fastLimit = 1e12;
+
+Output::Output(int fd) : fd(fd), buffer(bufferSize), used(0), interactive(isatty(fd)) {}
+
+Output::Output() : fd(-1), used(0), interactive(false) {}
+
+Output::~Output() {
+	flush();
+}
+
+Output& Output::operator<< (const char* text) {
+	write(text, strlen(text));
+	return *this;
+}
+
+Output& Output::operator<< (const string& text) {
+	write(text.data(), text.size());
+	return *this;
+}
+
+Output& Output::operator<< (char c) {
+	write(&c, 1);
+	return *this;
+}
+
+Output& Output::operator<< (double value) {
+	char text[350];
+	write(text, formatFixed3(value, text));
+	return *this;
+}
+
+Output& Output::operator<< (long value) {
+	char text[24];
+	char* p = text + sizeof(text);
+	unsigned long magnitude = value < 0 ? 0ul - (unsigned long)value : value;
+	do {
+		*--p = '0' + magnitude%10;
+		magnitude /= 10;
+	} while (magnitude != 0);
+	if (value < 0) *--p = '-';
+	write(p, text + sizeof(text) - p);
+	return *this;
+}
+
+void Output::endLine() {
+	write("\n", 1);
+	if (interactive) flush();
+}
+
+/* The data may be written in several parts, and the writes interrupted by a signal are repeated. */
+void Output::flush() {
+	if (fd < 0) return;
+	size_t written = 0;
+	while (written < used) {
+		ssize_t bytes = ::write(fd, buffer.data() + written, used - written);
+		if (bytes < 0 and errno == EINTR) continue;
+		if (bytes <= 0) break;
+		written += bytes;
+	}
+	used = 0;
+}
+
+void Output::append(Output& captured) {
+	write(captured.buffer.data(), captured.used);
+	vector<char>().swap(captured.buffer);
+	captured.used = 0;
+}
+
+/* In memory, the buffer grows as needed; otherwise, it is written when it is full. */
+void Output::write(const char* data, size_t size) {
+	if (size == 0) return;
+	if (used + size > buffer.size()) {
+		if (fd < 0) buffer.resize(max(2*buffer.size(), used + size));
+		else {
+			flush();
+			if (size > buffer.size()) buffer.resize(size);
+		}
+	}
+	memcpy(buffer.data() + used, data, size);
+	used += size;
+}
+
+Output& endLine(Output& output) {
+	output.endLine();
+	return output;
+}
+
+/* The number of thousandths is the magnitude multiplied by 1000 and rounded to the nearest integer. The product has a relative error
+of at most 2^-53, so the rounding is only in doubt when the fractional part of the product is that close to one half; in that case
+(and for large numbers, infinities and NaNs), the number is formatted with "snprintf", which rounds the exact binary value.
+The sign is written whenever the sign bit is set, so that small negative numbers give "-0.000", as in printf. */
+int formatFixed3(double value, char* text) {
+	double magnitude = fabs(value);
+	if (not (magnitude < fastLimit)) return snprintf(text, 350, "%.3f", value);
+	double scaled = magnitude*1000;
+	double rounded = nearbyint(scaled);
+	if (fabs(fabs(scaled - rounded) - 0.5) <= scaled*2.3e-16) return snprintf(text, 350, "%.3f", value);
+
+	uint64_t thousandths = uint64_t(rounded);
+	char digits[24];
+	char* p = digits + sizeof(digits);
+	for (int i = 0; i < 3; ++i) {
+		*--p = '0' + thousandths%10;
+		thousandths /= 10;
+	}
+	*--p = '.';
+	do {
+		*--p = '0' + thousandths%10;
+		thousandths /= 10;
+	} while (thousandths != 0);
+	if (signbit(value)) *--p = '-';
+	int size = digits + sizeof(digits) - p;
+	memcpy(text, p, size);
+	return size;
+}
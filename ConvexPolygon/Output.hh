@@ -0,0 +1,66 @@
+#ifndef Output_hh
+#define Output_hh
+#include <string>
+#include <vector>
+using namespace std;
+
+/* The Output class writes the responses of the calculator to a file descriptor through a large buffer, so that a script with many commands
+does not make a system call per line. The buffer is written when it is full, when "flush" is called and, if the file descriptor is a terminal,
+at the end of every line. The numbers are formatted without streams, with the same result as the "fixed" format with three decimals.
+An Output can also keep the text in memory, to be appended later to another Output. */
+
+class Output {
+
+public:
+	/** Constructor. The text is written to the file descriptor "fd". */
+	explicit Output(int fd);
+
+	/** Constructor. The text is kept in memory. */
+	Output();
+
+	/** Destructor. Writes what is left in the buffer. */
+	~Output();
+
+	/** Writes a text. */
+	Output& operator<< (const char* text);
+	Output& operator<< (const string& text);
+	Output& operator<< (char c);
+
+	/** Writes a number with three decimals, exactly as printf("%.3f") does. */
+	Output& operator<< (double value);
+
+	/** Writes an integer. */
+	Output& operator<< (long value);
+	Output& operator<< (int value) { return *this << long(value); }
+
+	/** Applies a manipulator, such as "endLine". */
+	Output& operator<< (Output& (*manipulator)(Output&)) { return manipulator(*this); }
+
+	/** Ends the current line. The buffer is written if the output is interactive. */
+	void endLine();
+
+	/** Writes the contents of the buffer to the file descriptor (it does nothing when the text is kept in memory). */
+	void flush();
+
+	/** Appends the text kept in memory by "captured", which becomes empty. */
+	void append(Output& captured);
+
+private:
+
+	/** Appends "size" characters to the buffer. */
+	void write(const char* data, size_t size);
+
+	/** File descriptor ("-1" when the text is kept in memory), buffer and number of characters of the buffer in use. */
+	int fd;
+	vector<char> buffer;
+	size_t used;
+	bool interactive;
+};
+
+/** Manipulator that ends the current line (the equivalent of "endl"). */
+Output& endLine(Output& output);
+
+/** Stores in "text" the number with three decimals, as printf("%.3f") does, and returns the number of characters (at most 350, without a null character). */
+int formatFixed3(double value, char* text);
+
+#endif
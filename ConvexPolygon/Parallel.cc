@@ -0,0 +1,85 @@
+#include "Parallel.hh"
+#include <thread>
+using namespace std;
+
+/* "hardware_concurrency" may return 0 when the value is not computable, in which case we work with one thread. */
+int hardwareThreads() {
+	int threads = thread::hardware_concurrency();
+	return (threads > 0) ? threads : 1;
+}
+
+/* Worker of the current thread: the pool where it works and the index of its queue. */
+static thread_local TaskPool* currentPool = nullptr;
+static thread_local int currentWorker = -1;
+
+TaskPool::TaskPool(int threads) : available(0), stopping(false), nextQueue(0) {
+	threads = max(threads, 1);
+	for (int t = 0; t < threads; ++t) queues.push_back(unique_ptr<Queue>(new Queue()));
+	for (int t = 0; t < threads; ++t) workers.push_back(thread(&TaskPool::work, this, t));
+}
+
+TaskPool::~TaskPool() {
+	{
+		lock_guard<mutex> guard(sleepLock);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+	for (thread& worker : workers) worker.join();
+}
+
+/* The counter of available tasks is increased after the task is in a queue, so a worker that finds it positive will find a task
+(unless another worker takes it first, and then it looks again). */
+void TaskPool::submit(function<void()> task) {
+	int index;
+	if (currentPool == this) index = currentWorker;
+	else {
+		lock_guard<mutex> guard(sleepLock);
+		index = nextQueue++ % queues.size();
+	}
+	{
+		lock_guard<mutex> guard(queues[index]->lock);
+		queues[index]->tasks.push_back(std::move(task));
+	}
+	{
+		lock_guard<mutex> guard(sleepLock);
+		++available;
+	}
+	wakeUp.notify_one();
+}
+
+bool TaskPool::take(int index, function<void()>& task) {
+	for (size_t k = 0; k < queues.size(); ++k) {
+		Queue& queue = *queues[(index + k) % queues.size()];
+		lock_guard<mutex> guard(queue.lock);
+		if (queue.tasks.empty()) continue;
+		if (k == 0) {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+		} else {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+		}
+		return true;
+	}
+	return false;
+}
+
+void TaskPool::work(int index) {
+	currentPool = this;
+	currentWorker = index;
+	function<void()> task;
+	while (true) {
+		{
+			unique_lock<mutex> guard(sleepLock);
+			wakeUp.wait(guard, [this] { return stopping or available > 0; });
+			if (stopping) return;
+		}
+		if (not take(index, task)) continue;
+		{
+			lock_guard<mutex> guard(sleepLock);
+			--available;
+		}
+		task();
+		task = nullptr;
+	}
+}
@@ -0,0 +1,101 @@
+#ifndef Parallel_hh
+#define Parallel_hh
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+using namespace std;
+
+/* Small helpers to split work between the hardware threads of the machine.
+They are used by the ConvexPolygon algorithms that must handle millions of points. */
+
+/** Returns the number of threads that the machine can run at the same time (at least 1). */
+int hardwareThreads();
+
+/** Calls "f(t)" for every t in [0 ... tasks-1], each call in its own thread, and waits for all of them. */
+template <typename Function>
+void parallelFor(int tasks, Function f) {
+	if (tasks <= 1) {
+		if (tasks == 1) f(0);
+		return;
+	}
+	vector<thread> workers;
+	for (int t = 1; t < tasks; ++t) workers.push_back(thread(f, t));
+	f(0);
+	for (thread& worker : workers) worker.join();
+}
+
+/** Sorts the range [first, last) with the comparator "comp". The range is split in "tasks" chunks that are sorted
+	in parallel, and then the sorted chunks are merged two by two, also in parallel. */
+template <typename Iterator, typename Compare>
+void parallelSort(Iterator first, Iterator last, Compare comp, int tasks) {
+	long size = last - first;
+	if (tasks <= 1 or size < 2*tasks) {
+		sort(first, last, comp);
+		return;
+	}
+	vector<long> bounds(tasks + 1);
+	for (int t = 0; t <= tasks; ++t) bounds[t] = size*t/tasks;
+	parallelFor(tasks, [&](int t) { sort(first + bounds[t], first + bounds[t+1], comp); });
+
+	/* In every round, chunk "t" is merged with chunk "t + step". */
+	for (int step = 1; step < tasks; step *= 2) {
+		int merges = (tasks + 2*step - 1)/(2*step);
+		parallelFor(merges, [&](int m) {
+			int t = m*2*step;
+			if (t + step < tasks) {
+				long end = bounds[min(t + 2*step, tasks)];
+				inplace_merge(first + bounds[t], first + bounds[t + step], first + end, comp);
+			}
+		});
+	}
+}
+
+/* The TaskPool class runs tasks on a fixed set of worker threads with work stealing: every worker has its own queue of tasks,
+where it puts the tasks submitted while it runs another one and from which it takes the most recent task first.
+When its queue is empty, a worker steals the oldest task of another queue. Tasks submitted from other threads are spread among the queues. */
+
+class TaskPool {
+
+public:
+	/** Constructor. Starts "threads" workers (at least one). */
+	explicit TaskPool(int threads);
+
+	/** Destructor. Waits for the running tasks and stops the workers; the tasks that have not started are not run. */
+	~TaskPool();
+
+	/** Adds a task to the pool. */
+	void submit(function<void()> task);
+
+private:
+
+	/** Queue of tasks of a worker. */
+	struct Queue {
+		mutex lock;
+		deque<function<void()>> tasks;
+	};
+
+	vector<unique_ptr<Queue>> queues;
+	vector<thread> workers;
+
+	/** Number of tasks in the queues, used by the idle workers to sleep until there is something to do. */
+	mutex sleepLock;
+	condition_variable wakeUp;
+	long available;
+	bool stopping;
+
+	/** Queue where the tasks submitted from other threads go next. */
+	unsigned nextQueue;
+
+	/** Loop of the worker "index". */
+	void work(int index);
+
+	/** Takes a task, first from the queue "index" and then from the other ones. Returns "false" if all of them are empty. */
+	bool take(int index, function<void()>& task);
+};
+
+#endif
@@ -19,18 +19,6 @@ Point::Point(double x_coord, double y_coord)
 
 
 
-/** Gets the x coordinate of this point. */
-double Point::get_x () const {
-    return x;
-}
-
-
-/** Gets the y coordinate of this point. */
-double Point::get_y () const {
-    return y;
-}
-
-
 /** Returns the distance to point p from this point. */
 double Point::distance (const Point& p) const {
     return sqrt(sqr(x - p.x) + sqr(y - p.y));
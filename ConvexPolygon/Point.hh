@@ -13,11 +13,11 @@ public:
     /** Constructor. */
     Point (double x_coord=0, double y_coord=0);
 
-    /** Gets the x coordinate of this point. */
-    double get_x () const;
+    /** Gets the x coordinate of this point. Defined here so that it can be inlined. */
+    double get_x () const { return x; }
 
-    /** Gets the y coordinate of this point. */
-    double get_y () const;
+    /** Gets the y coordinate of this point. Defined here so that it can be inlined. */
+    double get_y () const { return y; }
 
     /** Returns the distance to point p from this point. */
     double distance (const Point& p) const;
@@ -0,0 +1,227 @@
+#include "PolygonStore.hh"
+#include "Journal.hh"
+#include <algorithm>
+#include <cstring>
+using namespace std;
+
+const size_t VertexArena::smallestBlock;
+const size_t VertexArena::largestBlock;
+
+VertexArena::VertexArena() : blockUsed(0), blockCapacity(0), capacity(0), used(0), garbage(0) {}
+
+/* The X coordinates go first and the Y coordinates right after them. A copy that does not fit in what is left of the current block
+starts a new one, and the rest of the old block is never used, so the blocks grow to keep that waste small compared with what they hold. The copy borrows the block, so the block is freed with its last copy. */
+VertexArray VertexArena::copy(const VertexArray& points) {
+	size_t n = points.size();
+	if (n == 0) return VertexArray();
+	double* x;
+	shared_ptr<double> owner;
+	{
+		lock_guard<mutex> guard(lock);
+		if (blockUsed + 2*n > blockCapacity) {
+			blockCapacity = max(min(2*blockCapacity, largestBlock), max(smallestBlock, 2*n));
+			block = shared_ptr<double>(new double[blockCapacity], default_delete<double[]>());
+			blockUsed = 0;
+			capacity += blockCapacity;
+		}
+		x = block.get() + blockUsed;
+		blockUsed += 2*n;
+		used += 2*n;
+		owner = block;
+	}
+	memcpy(x, points.xs(), n*sizeof(double));
+	memcpy(x + n, points.ys(), n*sizeof(double));
+	return VertexArray(x, x + n, n, owner);
+}
+
+void VertexArena::release(int vertices) {
+	lock_guard<mutex> guard(lock);
+	used -= 2*vertices;
+	garbage += 2*vertices;
+}
+
+void VertexArena::reuse(int vertices) {
+	lock_guard<mutex> guard(lock);
+	used += 2*vertices;
+	garbage -= 2*vertices;
+}
+
+void VertexArena::clear() {
+	lock_guard<mutex> guard(lock);
+	block.reset();
+	blockUsed = blockCapacity = 0;
+	capacity = used = garbage = 0;
+}
+
+size_t VertexArena::capacityBytes() const {
+	lock_guard<mutex> guard(lock);
+	return capacity*sizeof(double);
+}
+
+size_t VertexArena::usedBytes() const {
+	lock_guard<mutex> guard(lock);
+	return used*sizeof(double);
+}
+
+size_t VertexArena::garbageBytes() const {
+	lock_guard<mutex> guard(lock);
+	return garbage*sizeof(double);
+}
+
+/* Implementation of the class PolygonStore */
+
+/* The vector of names points to the keys of the hash table, whose nodes never move, so every identifier is stored only once. */
+Handle PolygonStore::intern(const string& name) {
+	auto it = handles.find(name);
+	if (it != handles.end()) return it->second;
+	Handle h = records.size();
+	it = handles.insert({name, h}).first;
+	names.push_back(&it->first);
+	records.emplace_back();
+	return h;
+}
+
+void PolygonStore::releaseVertices(PolygonRecord& record) {
+	if (record.arenaVertices > 0) arena.release(record.arenaVertices);
+	record.arenaVertices = 0;
+}
+
+/* The vertices are copied into the arena before the polygon is moved to its record, so its own arrays are freed here. Small polygons,
+whose vertices are stored inside the polygon itself, are moved to the record as they are (unless they borrow their vertices). The cached properties of the polygon are computed now, so that it is not modified while several threads read it. */
+void PolygonStore::setPolygon(Handle h, ConvexPolygon polygon) {
+	save(h);
+	PolygonRecord& record = records[h];
+	releaseVertices(record);
+	int n = polygon.getVertices();
+	if (n > VertexArray::inlineCapacity or (n > 0 and polygon.getPoints().borrowed())) {
+		polygon.setStorage(arena.copy(polygon.getPoints()));
+		record.arenaVertices = n;
+	}
+	polygon.getArea();
+	record.polygon = std::move(polygon);
+	record.defined = true;
+	if (journal != nullptr) journal->recordPolygon(*names[h], record.polygon.getPoints());
+}
+
+void PolygonStore::setMappedPolygon(Handle h, ConvexPolygon polygon) {
+	save(h);
+	PolygonRecord& record = records[h];
+	releaseVertices(record);
+	polygon.getArea();
+	record.polygon = std::move(polygon);
+	record.defined = true;
+	if (journal != nullptr) journal->recordPolygon(*names[h], record.polygon.getPoints());
+}
+
+void PolygonStore::setColor(Handle h, const unsigned char rgba[4]) {
+	save(h);
+	memcpy(records[h].rgba, rgba, 4);
+	if (journal != nullptr) journal->recordColor(*names[h], rgba);
+}
+
+vector<Handle> PolygonStore::sortedHandles() const {
+	vector<Handle> sorted;
+	for (Handle h = 0; h < size(); ++h) {
+		if (records[h].defined) sorted.push_back(h);
+	}
+	sort(sorted.begin(), sorted.end(), [this](Handle a, Handle b) { return *names[a] < *names[b]; });
+	return sorted;
+}
+
+/* While there are checkpoints, the garbage is mostly the vertices of the versions saved in the undo log, which compacting would not free. */
+bool PolygonStore::needsCompaction() const {
+	if (not marks.empty()) return false;
+	size_t garbage = arena.garbageBytes();
+	return garbage > arena.usedBytes() and garbage > VertexArena::smallestBlock*sizeof(double);
+}
+
+void PolygonStore::compactIfNeeded() {
+	if (needsCompaction()) compact();
+}
+
+/* Every polygon is copied from its old block, which its record keeps alive until the new copy replaces it. */
+void PolygonStore::compact() {
+	arena.clear();
+	for (PolygonRecord& record : records) {
+		if (record.arenaVertices > 0) record.polygon.setStorage(arena.copy(record.polygon.getPoints()));
+	}
+}
+
+/* The hash table is counted as its array of buckets plus a node per identifier, with the key, the handle and a pointer to the next node.
+Every record is counted with the name pointer that goes with it, but without the vertices stored inside its polygon.
+Only the identifiers of the polygons count as names: the ones interned without a polygon (written by a command that failed, or interned
+by the batch mode before the command that creates them runs) are overhead. */
+StoreMemory PolygonStore::memory() const {
+	StoreMemory memory = {0, 0, 0, 0, 0, 0};
+	size_t arenaVertices = 0, inlineVertices = 0, unusedNames = 0;
+	for (Handle h = 0; h < size(); ++h) {
+		const PolygonRecord& record = records[h];
+		if (record.defined) {
+			memory.vertices += 2*sizeof(double)*record.polygon.getVertices();
+			++memory.polygons;
+		}
+		arenaVertices += 2*sizeof(double)*record.arenaVertices;
+		if (record.defined and record.arenaVertices == 0 and not record.polygon.getPoints().borrowed()) {
+			inlineVertices += 2*sizeof(double)*record.polygon.getVertices();
+		}
+		if (record.defined) memory.names += names[h]->size();
+		else unusedNames += names[h]->size();
+	}
+	memory.arena = arena.capacityBytes();
+	memory.garbage = arena.garbageBytes();
+	size_t table = handles.bucket_count()*sizeof(void*) + handles.size()*(sizeof(pair<const string, Handle>) + sizeof(void*));
+	memory.overhead = table + unusedNames + records.size()*(sizeof(PolygonRecord) + sizeof(const string*)) - inlineVertices + (memory.arena - arenaVertices);
+	memory.overhead += undoLog.capacity()*sizeof(UndoEntry);
+	return memory;
+}
+
+/* The records are compared with the number of the last checkpoint, so a record changed many times is saved only once per checkpoint.
+The records are changed by one thread each, but several threads may save them at the same time. */
+void PolygonStore::save(Handle h) {
+	if (marks.empty()) return;
+	PolygonRecord& record = records[h];
+	long mark = marks.back().first;
+	if (record.saved == mark) return;
+	{
+		lock_guard<mutex> guard(undoLock);
+		undoLog.push_back({h, record});
+	}
+	record.saved = mark;
+}
+
+void PolygonStore::checkpoint() {
+	marks.push_back({++lastMark, undoLog.size()});
+	if (journal != nullptr) journal->recordMark(JournalCheckpoint);
+}
+
+/* The saved versions are put back from the last one, so a record saved by several checkpoints ends up as it was in the oldest of them,
+and the vertices in the arena are counted as used or as garbage again. */
+bool PolygonStore::rollback(vector<Handle>& restored) {
+	if (marks.empty()) return false;
+	size_t first = marks.back().second;
+	marks.pop_back();
+	restored.clear();
+	while (undoLog.size() > first) {
+		UndoEntry& entry = undoLog.back();
+		PolygonRecord& record = records[entry.h];
+		releaseVertices(record);
+		if (entry.record.arenaVertices > 0) arena.reuse(entry.record.arenaVertices);
+		record = std::move(entry.record);
+		restored.push_back(entry.h);
+		undoLog.pop_back();
+	}
+	if (marks.empty()) undoLog = vector<UndoEntry>();
+	if (journal != nullptr) journal->recordMark(JournalRollback);
+	return true;
+}
+
+/* The versions saved since the last checkpoint now belong to the previous one, if any, since rolling it back must also undo these changes.
+The records saved by the removed checkpoint are saved again if they change, which only costs some space. Without checkpoints, the saved versions
+are dropped: their vertices in the arena were already counted as garbage when they were replaced. */
+bool PolygonStore::commit() {
+	if (marks.empty()) return false;
+	marks.pop_back();
+	if (marks.empty()) undoLog = vector<UndoEntry>();
+	if (journal != nullptr) journal->recordMark(JournalCommit);
+	return true;
+}
@@ -0,0 +1,192 @@
+#ifndef PolygonStore_hh
+#define PolygonStore_hh
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include "ConvexPolygon.hh"
+using namespace std;
+
+class Journal;
+
+/* The PolygonStore class keeps the polygons of the calculator with their colors. Every identifier is interned once: it gets a handle,
+a dense integer that indexes a record with the polygon and its color, so the commands find a polygon with a single hash lookup
+and then use the handle. The records never move, so references to them stay valid when new identifiers are added.
+The coordinates of the vertices are copied into a VertexArena, a few large blocks shared by all the polygons, instead of a block per polygon
+(the small polygons keep them inside their record).
+The space of the polygons that are replaced is only counted as garbage; when there is more garbage than coordinates in use, the store is compacted:
+the coordinates in use are copied to new blocks, and the old blocks are freed as soon as no copy of a polygon borrows them.
+Polygons loaded from a binary file keep borrowing the memory where the file is mapped.
+A checkpoint saves the state of the polygons and colors in O(1) time: from then on, the first change of every record saves its previous version
+in an undo log (a copy of its polygon, which shares its vertices), and a rollback puts back the saved versions, in time proportional to the
+records changed since the checkpoint. Checkpoints can be nested. The store is not compacted while there are checkpoints, since the vertices
+of the saved versions are still in use.
+If the store has a journal, every change of a polygon or a color, and every checkpoint, rollback and commit, is recorded in it.
+Different records can be changed at the same time from different threads, but adding identifiers, compacting and the checkpoints must be done alone. */
+
+/** Handle of an interned identifier. */
+typedef int Handle;
+
+/** Handle of the identifiers that have not been interned. */
+const Handle noHandle = -1;
+
+/** Blocks of memory where the coordinates of the polygons are stored, one polygon after the other (first its X coordinates and then its Y coordinates). */
+class VertexArena {
+
+public:
+	/** Constructor. The arena is empty. */
+	VertexArena();
+
+	/** Returns a copy of the given vertices stored in the arena. It keeps alive the block where it is stored. Can be called from several threads. */
+	VertexArray copy(const VertexArray& points);
+
+	/** Reports that a copy with the given number of vertices is no longer used. Can be called from several threads. */
+	void release(int vertices);
+
+	/** Reports that a copy with the given number of vertices, which was no longer used, is used again. */
+	void reuse(int vertices);
+
+	/** Forgets all the blocks (they are freed when no copy uses them) and starts again. */
+	void clear();
+
+	/** Returns the bytes of the blocks, and the bytes of the copies in use and no longer used. */
+	size_t capacityBytes() const;
+	size_t usedBytes() const;
+	size_t garbageBytes() const;
+
+	/** Numbers of coordinates of the first block and of the largest ones: every block is twice as big as the previous one, up to the largest size,
+		but a polygon with more coordinates gets a block of its own. */
+	static const size_t smallestBlock = 1 << 12;
+	static const size_t largestBlock = 1 << 20;
+
+private:
+	mutable mutex lock;
+	shared_ptr<double> block;       // Block where the next copy goes,
+	size_t blockUsed, blockCapacity;  // with its used and total coordinates.
+	size_t capacity, used, garbage;   // Coordinates in all the blocks.
+};
+
+/** Polygon of the store, with its color. */
+struct PolygonRecord {
+	ConvexPolygon polygon;
+	unsigned char rgba[4];
+	bool defined;                  // "false" until a polygon is stored (the identifier may have been interned before).
+	int arenaVertices;             // Vertices stored in the arena ("0" if they are stored inside the polygon or borrowed from a file).
+	long saved;                    // Checkpoint in which the previous version of the record was saved ("0" if none).
+
+	PolygonRecord() : rgba{0, 0, 0, 255}, defined(false), arenaVertices(0), saved(0) {}
+};
+
+/** Memory used by the store, in bytes. */
+struct StoreMemory {
+	size_t vertices;               // Coordinates of the polygons.
+	size_t names;                  // Characters of the identifiers of the polygons.
+	size_t overhead;               // Records, hash table, and space of the arena that is not used or is garbage.
+	size_t arena, garbage;         // Blocks of the arena, and garbage in them.
+	int polygons;
+};
+
+class PolygonStore {
+
+public:
+	/** Returns the handle of an identifier, or "noHandle" if it has not been interned. */
+	Handle find(const string& name) const {
+		auto it = handles.find(name);
+		return it == handles.end() ? noHandle : it->second;
+	}
+
+	/** Returns the handle of an identifier, interning it if needed. */
+	Handle intern(const string& name);
+
+	/** Returns the handle of an identifier if it has a polygon, or "noHandle" otherwise. */
+	Handle findDefined(const string& name) const {
+		Handle h = find(name);
+		return (h != noHandle and records[h].defined) ? h : noHandle;
+	}
+
+	/** Returns the number of handles. */
+	int size() const { return records.size(); }
+
+	/** Returns the identifier of a handle. */
+	const string& name(Handle h) const { return *names[h]; }
+
+	/** Returns "true" if the handle has a polygon. */
+	bool defined(Handle h) const { return records[h].defined; }
+
+	/** Returns the polygon of a handle (empty if it is not defined). */
+	const ConvexPolygon& polygon(Handle h) const { return records[h].polygon; }
+
+	/** Returns the color of a handle, as red, green, blue and alpha values from 0 to 255. */
+	const unsigned char* color(Handle h) const { return records[h].rgba; }
+
+	/** Stores the polygon of a handle, copying its vertices into the arena unless they fit inside the polygon. The color does not change (it is black for a new polygon). */
+	void setPolygon(Handle h, ConvexPolygon polygon);
+
+	/** Stores the polygon of a handle, which keeps borrowing its vertices (they must be borrowed from a file mapping). */
+	void setMappedPolygon(Handle h, ConvexPolygon polygon);
+
+	/** Changes the color of a handle. */
+	void setColor(Handle h, const unsigned char rgba[4]);
+
+	/** Returns the handles that have a polygon, sorted by their identifiers. */
+	vector<Handle> sortedHandles() const;
+
+	/** Returns "true" if the garbage of the arena is more than the coordinates in use (and more than the first block), and there are no checkpoints. */
+	bool needsCompaction() const;
+
+	/** Compacts the arena if it needs it. */
+	void compactIfNeeded();
+
+	/** Copies the coordinates in use to new blocks of the arena, in the order of the handles. */
+	void compact();
+
+	/** Returns the memory used by the store. */
+	StoreMemory memory() const;
+
+	/** Saves the current polygons and colors, so that "rollback" can go back to them. */
+	void checkpoint();
+
+	/** Returns the number of checkpoints that have not been rolled back nor committed. */
+	int checkpoints() const { return marks.size(); }
+
+	/** Puts back the polygons and colors saved by the last checkpoint, and removes it. The identifiers interned since then stay, without polygon.
+		Stores in "restored" the handles that have changed. Returns "false" if there is no checkpoint. */
+	bool rollback(vector<Handle>& restored);
+
+	/** Removes the last checkpoint, keeping the current polygons and colors (a previous checkpoint still goes back to its own state).
+		Returns "false" if there is no checkpoint. */
+	bool commit();
+
+	/** Records the next changes in "journal" ("nullptr" to stop recording them). */
+	void setJournal(Journal* journal) { this->journal = journal; }
+
+private:
+	unordered_map<string, Handle> handles;
+	vector<const string*> names;      // Keys of "handles", by handle.
+	deque<PolygonRecord> records;
+	VertexArena arena;
+
+	/** Previous versions of the records changed since the first checkpoint, in the order in which they were saved. */
+	struct UndoEntry {
+		Handle h;
+		PolygonRecord record;
+	};
+	vector<UndoEntry> undoLog;
+	mutex undoLock;
+
+	/** For every checkpoint, its number and the size of the undo log when it was made. The numbers are never reused. */
+	vector<pair<long, size_t>> marks;
+	long lastMark = 0;
+
+	Journal* journal = nullptr;
+
+	/** Releases the vertices of a record that are stored in the arena. */
+	void releaseVertices(PolygonRecord& record);
+
+	/** Saves the current version of a record before it is changed, unless it has already been saved since the last checkpoint. */
+	void save(Handle h);
+};
+
+#endif
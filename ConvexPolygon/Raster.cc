@@ -0,0 +1,193 @@
+#include "Raster.hh"
+#include <pngwriter.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstdio>
+using namespace std;
+
+Raster::Raster(int width, int height) : _width(width), _height(height), _pixels(4*size_t(width)*height, 255) {}
+
+/* An opaque color replaces the pixels. Otherwise, every channel becomes color*alpha + pixel*(1 - alpha), in integers rounded to the nearest:
+for 0 <= v <= 255*255, round(v/255) is (t + (t >> 8)) >> 8 with t = v + 128, which avoids the divisions. */
+void Raster::blendSpan(int j, int first, int last, const unsigned char rgba[4]) {
+	unsigned char* p = &_pixels[4*(size_t(j)*_width + first)];
+	unsigned char* end = p + 4*(last - first + 1);
+	int alpha = rgba[3];
+	if (alpha == 0) return;
+	if (alpha == 255) {
+		for (; p != end; p += 4) {
+			p[0] = rgba[0];
+			p[1] = rgba[1];
+			p[2] = rgba[2];
+			p[3] = 255;
+		}
+		return;
+	}
+	int rest = 255 - alpha;
+	int red = rgba[0]*alpha + 128, green = rgba[1]*alpha + 128, blue = rgba[2]*alpha + 128;
+	for (; p != end; p += 4) {
+		int t0 = p[0]*rest + red, t1 = p[1]*rest + green, t2 = p[2]*rest + blue, t3 = p[3]*rest + 128;
+		p[0] = (t0 + (t0 >> 8)) >> 8;
+		p[1] = (t1 + (t1 >> 8)) >> 8;
+		p[2] = (t2 + (t2 >> 8)) >> 8;
+		p[3] = alpha + ((t3 + (t3 >> 8)) >> 8);
+	}
+}
+
+/* The rows touched by the polygon are the ones from floor(ymin) to ceil(ymax) - 1 (the top of a polygon that ends just on the line between two rows
+does not spill over the upper one). What the polygon covers in the row j is the part of it between the lines y = j and y = j + 1, which is convex:
+its leftmost and rightmost points are either vertices in that strip or points where the edges cross one of the two lines.
+A pixel of the row is not touched by the boundary when its four corners are strictly inside the polygon, that is, when the row is strictly
+between the lowest and highest vertices and the pixel is strictly inside the crossings of both lines. */
+void Raster::drawConvex(const double* x, const double* y, int n, const unsigned char rgba[4], bool fill, int rowBegin, int rowEnd, RasterScratch& scratch) {
+	if (n == 0) return;
+	double ymin = y[0], ymax = y[0];
+	for (int i = 0; i < n; ++i) {
+		if (not isfinite(x[i]) or not isfinite(y[i])) return;
+		ymin = min(ymin, y[i]);
+		ymax = max(ymax, y[i]);
+	}
+	double lowest = floor(ymin);
+	double highest = ymax > ymin ? ceil(ymax) - 1 : lowest;
+	int first = int(max(lowest, double(max(rowBegin, 0))));
+	int last = int(min(highest, double(min(rowEnd, _height) - 1)));
+	if (first > last) return;
+	int rows = last - first + 1;
+
+	const double infinity = numeric_limits<double>::infinity();
+	vector<double>& low = scratch.low;
+	vector<double>& high = scratch.high;
+	vector<double>& spanMin = scratch.spanMin;
+	vector<double>& spanMax = scratch.spanMax;
+	low.assign(rows + 1, infinity);
+	high.assign(rows + 1, -infinity);
+	spanMin.assign(rows, infinity);
+	spanMax.assign(rows, -infinity);
+
+	/* Crossings of the edges with the lines y = first ... last + 1. */
+	for (int i = 0; n > 1 and i < n; ++i) {
+		int next = (i + 1 == n) ? 0 : i + 1;
+		double x0 = x[i], y0 = y[i], x1 = x[next], y1 = y[next];
+		if (y0 > y1) {
+			swap(x0, x1);
+			swap(y0, y1);
+		}
+		int k0 = int(max(ceil(y0), double(first)));
+		int k1 = int(min(floor(y1), double(last + 1)));
+		for (int k = k0; k <= k1; ++k) {
+			double left, right;
+			if (y1 == y0) {
+				left = min(x0, x1);
+				right = max(x0, x1);
+			} else left = right = x0 + (k - y0)*(x1 - x0)/(y1 - y0);
+			low[k - first] = min(low[k - first], left);
+			high[k - first] = max(high[k - first], right);
+		}
+	}
+	/* Vertices: a vertex on the line between two rows is in the strips of both. */
+	for (int i = 0; i < n; ++i) {
+		double j = floor(y[i]);
+		for (double row : {j, y[i] == j ? j - 1 : j}) {
+			if (row < first or row > last) continue;
+			int r = int(row) - first;
+			spanMin[r] = min(spanMin[r], x[i]);
+			spanMax[r] = max(spanMax[r], x[i]);
+		}
+	}
+
+	for (int r = 0; r < rows; ++r) {
+		double left = min(spanMin[r], min(low[r], low[r + 1]));
+		double right = max(spanMax[r], max(high[r], high[r + 1]));
+		if (left > right) continue;
+		double a = floor(left);
+		double b = right > left ? ceil(right) - 1 : a;
+		if (b < 0 or a >= _width) continue;
+		int begin = int(max(a, 0.0));
+		int end = int(min(b, double(_width - 1)));
+		int j = first + r;
+		if (fill or not (j > ymin and j + 1 < ymax)) {
+			blendSpan(j, begin, end, rgba);
+			continue;
+		}
+		double c = floor(max(low[r], low[r + 1])) + 1;
+		double d = ceil(min(high[r], high[r + 1])) - 2;
+		if (c > d or d < begin or c > end) blendSpan(j, begin, end, rgba);
+		else {
+			if (c > begin) blendSpan(j, begin, int(c) - 1, rgba);
+			if (d < end) blendSpan(j, int(d) + 1, end, rgba);
+		}
+	}
+}
+
+bool Raster::blank() const {
+	for (size_t i = 0; i < _pixels.size(); i += 4) {
+		if (_pixels[i] != 255 or _pixels[i + 1] != 255 or _pixels[i + 2] != 255) return false;
+	}
+	return true;
+}
+
+/* Only the pixels that are not white are given to the PNG writer, whose image starts white. Its coordinates start at 1, and its channels go up to 65535.
+The PNG writer does not tell if the file could not be written, so the file is opened first to check it. */
+bool Raster::writePng(const string& nameFile) const {
+	FILE* file = fopen(nameFile.c_str(), "wb");
+	if (file == nullptr) return false;
+	fclose(file);
+	pngwriter png(_width, _height, 1.0, nameFile.c_str());
+	for (int j = 0; j < _height; ++j) {
+		for (int i = 0; i < _width; ++i) {
+			const unsigned char* p = pixel(i, j);
+			if (p[0] == 255 and p[1] == 255 and p[2] == 255) continue;
+			png.plot(i + 1, j + 1, p[0]*257, p[1]*257, p[2]*257);
+		}
+	}
+	png.close();
+	return true;
+}
+
+void colorToRgba(const vector<double>* color, unsigned char rgba[4]) {
+	for (int c = 0; c < 4; ++c) {
+		double value = (c == 3) ? 1 : 0;
+		if (color != nullptr and c < int(color->size())) value = (*color)[c];
+		rgba[c] = (unsigned char)lround(255*min(1.0, max(0.0, value)));
+	}
+}
+
+/* Sutherland-Hodgman: the polygon is clipped by the four sides of the box, one after the other. Every edge keeps the part of it that is
+on the inner side, so the result of clipping a convex polygon is still convex. */
+int clipConvex(const double* x, const double* y, int n, double xmin, double xmax, double ymin, double ymax, vector<double>& outX, vector<double>& outY) {
+	outX.assign(x, x + n);
+	outY.assign(y, y + n);
+	vector<double> inX, inY;
+	for (int side = 0; side < 4 and not outX.empty(); ++side) {
+		swap(inX, outX);
+		swap(inY, outY);
+		outX.clear();
+		outY.clear();
+		/* Signed distance to the side, positive inside. */
+		auto inside = [&](double px, double py) {
+			switch (side) {
+				case 0: return px - xmin;
+				case 1: return xmax - px;
+				case 2: return py - ymin;
+				default: return ymax - py;
+			}
+		};
+		int size = inX.size();
+		for (int i = 0; i < size; ++i) {
+			int previous = (i == 0) ? size - 1 : i - 1;
+			double d0 = inside(inX[previous], inY[previous]);
+			double d1 = inside(inX[i], inY[i]);
+			if ((d0 < 0) != (d1 < 0)) {
+				double t = d0/(d0 - d1);
+				outX.push_back(inX[previous] + t*(inX[i] - inX[previous]));
+				outY.push_back(inY[previous] + t*(inY[i] - inY[previous]));
+			}
+			if (d1 >= 0) {
+				outX.push_back(inX[i]);
+				outY.push_back(inY[i]);
+			}
+		}
+	}
+	return outX.size();
+}
@@ -0,0 +1,60 @@
+#ifndef Raster_hh
+#define Raster_hh
+#include <string>
+#include <vector>
+using namespace std;
+
+/* The Raster class is an RGBA image in memory where convex polygons are drawn, filled or as outlines, with alpha blending.
+The pixel (i, j) is the square [i, i+1) x [j, j+1) and the row 0 is at the bottom, as in the PNG writer. A polygon covers the pixels that it touches,
+so even points and segments are visible. Since the polygons are convex, they cover a single span of every row: the span is found from
+the points where the edges cross the lines between rows and from the vertices, so drawing a polygon takes a time proportional
+to its number of vertices plus its number of rows, plus the pixels that are written.
+Every call draws only a band of rows, so different threads can draw different bands of the same image at the same time. */
+
+/** Buffers used while drawing a polygon, reused by the calls made from the same thread. */
+struct RasterScratch {
+	vector<double> low, high;            // Where the polygon crosses the line between two rows.
+	vector<double> spanMin, spanMax;     // What it covers in every row.
+};
+
+class Raster {
+
+public:
+	/** Constructor. The image has the given size and is white and opaque. */
+	Raster(int width, int height);
+
+	int width() const { return _width; }
+	int height() const { return _height; }
+
+	/** Returns the red, green, blue and alpha values of the pixel (i, j), from 0 to 255. */
+	const unsigned char* pixel(int i, int j) const {
+		return &_pixels[4*(size_t(j)*_width + i)];
+	}
+
+	/** Draws, in the rows [rowBegin, rowEnd), the convex polygon with the "n" vertices (x[i], y[i]) given in order (in either direction),
+		blending the color "rgba" (from 0 to 255) with the image. With "fill", all the pixels that it touches are drawn; otherwise, only the ones
+		touched by its boundary. Every pixel is blended at most once. */
+	void drawConvex(const double* x, const double* y, int n, const unsigned char rgba[4], bool fill, int rowBegin, int rowEnd, RasterScratch& scratch);
+
+	/** Returns "true" if all the pixels are white. */
+	bool blank() const;
+
+	/** Writes the image to a PNG file (without its alpha channel, since the background is opaque). Returns "false" if the file cannot be written. */
+	bool writePng(const string& nameFile) const;
+
+private:
+	int _width, _height;
+	vector<unsigned char> _pixels;
+
+	/** Blends the color with the pixels [first, last] of the row "j". */
+	void blendSpan(int j, int first, int last, const unsigned char rgba[4]);
+};
+
+/** Stores in "rgba" the color given by its red, green and blue components and, optionally, its opacity, from 0 to 1 (black and opaque if "color" is null). */
+void colorToRgba(const vector<double>* color, unsigned char rgba[4]);
+
+/** Stores in (outX[i], outY[i]) the vertices of the part of the convex polygon with the "n" vertices (x[i], y[i]) that is inside the box
+	[xmin, xmax] x [ymin, ymax], in the same order, and returns their number ("0" if they have no point in common). */
+int clipConvex(const double* x, const double* y, int n, double xmin, double xmax, double ymin, double ymax, vector<double>& outX, vector<double>& outY);
+
+#endif
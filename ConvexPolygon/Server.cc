@@ -0,0 +1,212 @@
+#include "Server.hh"
+#include <algorithm>
+#include <thread>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <csignal>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+using namespace std;
+
+/* Implementation of the class ReadWriteLock */
+
+ReadWriteLock::ReadWriteLock() : readers(0), waitingWriters(0), writer(false) {}
+
+void ReadWriteLock::lockShared() {
+	unique_lock<mutex> locked(guard);
+	changed.wait(locked, [this] { return not writer and waitingWriters == 0; });
+	++readers;
+}
+
+void ReadWriteLock::unlockShared() {
+	lock_guard<mutex> locked(guard);
+	if (--readers == 0) changed.notify_all();
+}
+
+void ReadWriteLock::lock() {
+	unique_lock<mutex> locked(guard);
+	++waitingWriters;
+	changed.wait(locked, [this] { return not writer and readers == 0; });
+	--waitingWriters;
+	writer = true;
+}
+
+void ReadWriteLock::unlock() {
+	lock_guard<mutex> locked(guard);
+	writer = false;
+	changed.notify_all();
+}
+
+/* Implementation of the class ResourceLocks */
+
+ResourceLocks::ResourceLocks(int stripes) : count(stripes), stripes(new ReadWriteLock[stripes]) {}
+
+/* The stripes are sorted with the written ones first, so when a stripe is both read and written only the write is kept. */
+void ResourceLocks::lock(const BatchAccess& access, vector<pair<int, bool>>& held) {
+	held.clear();
+	hash<string> hasher;
+	for (const string& name : access.reads) held.push_back({int(hasher(name) % count), false});
+	for (const string& name : access.writes) held.push_back({int(hasher(name) % count), true});
+	sort(held.begin(), held.end(), [](const pair<int, bool>& a, const pair<int, bool>& b) {
+		return a.first < b.first or (a.first == b.first and a.second > b.second);
+	});
+	held.erase(unique(held.begin(), held.end(), [](const pair<int, bool>& a, const pair<int, bool>& b) { return a.first == b.first; }), held.end());
+	for (const pair<int, bool>& stripe : held) {
+		if (stripe.second) stripes[stripe.first].lock();
+		else stripes[stripe.first].lockShared();
+	}
+}
+
+void ResourceLocks::unlock(const vector<pair<int, bool>>& held) {
+	for (const pair<int, bool>& stripe : held) {
+		if (stripe.second) stripes[stripe.first].unlock();
+		else stripes[stripe.first].unlockShared();
+	}
+}
+
+/* Stores in "address" the address of a socket at "path". Returns "false" if the path does not fit in it. */
+static bool socketAddress(const string& path, sockaddr_un& address) {
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.empty() or path.size() >= sizeof(address.sun_path)) return false;
+	memcpy(address.sun_path, path.c_str(), path.size());
+	return true;
+}
+
+/* A socket that nobody accepts connections from is left by a server that ended without removing it, so it is removed. Other files are never removed.
+The socket is created with another name and renamed once it listens, so a client that finds it can connect. */
+int listenSocket(const string& path) {
+	sockaddr_un address;
+	string temporary = path + ".tmp";
+	if (not socketAddress(temporary, address)) return -1;
+	struct stat info;
+	if (lstat(path.c_str(), &info) == 0) {
+		int running = connectSocket(path);
+		if (running >= 0) {
+			close(running);
+			return -1;
+		}
+		if (not S_ISSOCK(info.st_mode) or unlink(path.c_str()) != 0) return -1;
+	}
+	if (lstat(temporary.c_str(), &info) == 0 and (not S_ISSOCK(info.st_mode) or unlink(temporary.c_str()) != 0)) return -1;
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) return -1;
+	if (bind(fd, (const sockaddr*)&address, sizeof(address)) != 0) {
+		close(fd);
+		return -1;
+	}
+	if (listen(fd, SOMAXCONN) != 0 or rename(temporary.c_str(), path.c_str()) != 0) {
+		unlink(temporary.c_str());
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int connectSocket(const string& path) {
+	sockaddr_un address;
+	if (not socketAddress(path, address)) return -1;
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) return -1;
+	int result;
+	do result = connect(fd, (const sockaddr*)&address, sizeof(address));
+	while (result != 0 and errno == EINTR);
+	if (result != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* The connections are accepted by a thread of their own while the calling thread waits for the signals. Shutting the listener down
+makes "accept" fail, which ends that thread. When there are no descriptors left, it waits a moment for the sessions to close some. */
+void acceptSessions(int listener, const function<void(int, long)>& session) {
+	signal(SIGPIPE, SIG_IGN);
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+	thread acceptor([listener, &session] {
+		for (long number = 0; ; ) {
+			int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+			if (fd < 0) {
+				if (errno == EINTR or errno == ECONNABORTED) continue;
+				if (errno == EMFILE or errno == ENFILE or errno == ENOBUFS or errno == ENOMEM) {
+					this_thread::sleep_for(chrono::milliseconds(10));
+					continue;
+				}
+				return;
+			}
+			thread([fd, number, session] {
+				session(fd, number);
+				close(fd);
+			}).detach();
+			++number;
+		}
+	});
+	int received;
+	while (sigwait(&signals, &received) != 0) {}
+	shutdown(listener, SHUT_RDWR);
+	acceptor.join();
+}
+
+/* Writes the "size" bytes of "data" to "fd", repeating the writes that are partial or interrupted. */
+static bool writeAll(int fd, const char* data, size_t size) {
+	while (size > 0) {
+		ssize_t written = write(fd, data, size);
+		if (written < 0 and errno == EINTR) continue;
+		if (written <= 0) return false;
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+
+/* Both directions are handled by a single thread that waits for whichever is ready, and the commands are only sent when the socket can take them,
+so the answers are read while a long script is being sent (otherwise, the client and the server could block each other writing).
+The data read from "in" that has not been sent yet is in [sent, read) of "commands". */
+bool forward(int fd, int in, int out) {
+	signal(SIGPIPE, SIG_IGN);
+	vector<char> commands(1 << 16), answers(1 << 16);
+	size_t sent = 0, read = 0;
+	bool sending = true, ok = true;
+	while (true) {
+		pollfd waiting[2] = {{fd, short(POLLIN | (sent < read ? POLLOUT : 0)), 0}, {in, POLLIN, 0}};
+		if (poll(waiting, sending and sent == read ? 2 : 1, -1) < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		if (waiting[0].revents & POLLIN or waiting[0].revents & (POLLHUP | POLLERR)) {
+			ssize_t bytes = ::read(fd, answers.data(), answers.size());
+			if (bytes < 0 and errno == EINTR) continue;
+			if (bytes <= 0) return ok and bytes == 0 and not sending;
+			if (not writeAll(out, answers.data(), bytes)) ok = false;
+		}
+		if (sent < read and waiting[0].revents & POLLOUT) {
+			ssize_t bytes = send(fd, commands.data() + sent, read - sent, MSG_DONTWAIT);
+			if (bytes < 0 and (errno == EINTR or errno == EAGAIN)) continue;
+			if (bytes < 0) {
+				ok = sending = false;
+				sent = read = 0;
+			} else sent += bytes;
+			if (sent == read and not sending) shutdown(fd, SHUT_WR);
+		} else if (sending and sent == read and waiting[1].revents != 0) {
+			ssize_t bytes = ::read(in, commands.data(), commands.size());
+			if (bytes < 0 and errno == EINTR) continue;
+			sent = 0;
+			read = max(bytes, ssize_t(0));
+			if (bytes <= 0) {
+				if (bytes < 0) ok = false;
+				sending = false;
+				shutdown(fd, SHUT_WR);
+			}
+		}
+	}
+}
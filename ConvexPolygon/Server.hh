@@ -0,0 +1,79 @@
+#ifndef Server_hh
+#define Server_hh
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "Batch.hh"
+using namespace std;
+
+/* Pieces of the server mode of the calculator, where the polygons stay in memory and every client that connects to a Unix domain socket
+gets a session of its own, that runs its commands as they arrive. The commands of different sessions run at the same time: the ones that
+may use any polygon hold the whole store, and the other ones share it and only hold the identifiers and files that they use
+(the ones they write, alone, and the ones they only read, together with other readers). */
+
+/** Lock that is held either by any number of readers or by a single writer. A writer that waits goes before the readers that arrive after it,
+	so a stream of readers never keeps it waiting forever. */
+class ReadWriteLock {
+
+public:
+	/** Constructor. The lock is free. */
+	ReadWriteLock();
+
+	/** Takes the lock as a reader, and releases it. */
+	void lockShared();
+	void unlockShared();
+
+	/** Takes the lock as the writer, and releases it. */
+	void lock();
+	void unlock();
+
+private:
+	mutex guard;
+	condition_variable changed;
+	int readers;            // Readers that hold the lock.
+	int waitingWriters;     // Writers that wait for it.
+	bool writer;            // "true" if a writer holds the lock.
+};
+
+/** Locks of the resources used by the commands (polygon identifiers and files, named as in the BatchAccess of a command).
+	Every resource goes to one of a fixed number of stripes by its hash, so there is no lock per identifier (two resources of the same stripe
+	just wait for each other). The stripes of a command are taken in increasing order, so two commands never wait for each other at the same time. */
+class ResourceLocks {
+
+public:
+	/** Constructor. */
+	explicit ResourceLocks(int stripes = 1024);
+
+	/** Takes the locks of the resources of "access": as the writer for the resources that it writes and as a reader for the ones that it only reads.
+		Stores in "held" the stripes that it takes (and whether it writes them), to release them with "unlock". */
+	void lock(const BatchAccess& access, vector<pair<int, bool>>& held);
+
+	/** Releases the locks taken by "lock". */
+	void unlock(const vector<pair<int, bool>>& held);
+
+private:
+	int count;
+	unique_ptr<ReadWriteLock[]> stripes;
+};
+
+/** Creates a Unix domain socket that listens for connections at "path", replacing the socket left there by a server that is no longer running.
+	Returns its file descriptor, or "-1" if it cannot be created (for instance, if a server is running there or the path is not a socket). */
+int listenSocket(const string& path);
+
+/** Connects to the server that listens at "path". Returns the file descriptor of the connection, or "-1" if it cannot connect. */
+int connectSocket(const string& path);
+
+/** Accepts the connections of "listener" until the process gets SIGINT or SIGTERM, and calls "session(fd, number)" for each one in a thread of its own,
+	numbering them from 0. The connection is closed when the call returns. Once a signal arrives, no more connections are accepted and it returns,
+	while the sessions go on. The signals are blocked for the threads started from now on, and SIGPIPE is ignored, so a client that leaves
+	only fails the writes of its session. */
+void acceptSessions(int listener, const function<void(int, long)>& session);
+
+/** Sends to the socket "fd" all that can be read from the file descriptor "in" (and then closes its writing side), and writes to "out"
+	all that arrives from "fd" until the server closes it. Returns "false" if some data could not be sent or written. */
+bool forward(int fd, int in, int out);
+
+#endif
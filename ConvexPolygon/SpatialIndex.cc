@@ -0,0 +1,229 @@
+#include "SpatialIndex.hh"
+#include <algorithm>
+#include <queue>
+#include <cmath>
+#include <limits>
+using namespace std;
+
+/* Maximum number of children of a node. */
+static const int nodeCapacity = 16;
+
+/* The tree is built again when the changed polygons are more than this number, or more than a quarter of the polygons in the tree. */
+static const int changedLimit = 64;
+
+SpatialIndex::SpatialIndex() : liveEntries(0), touchedAll(false) {}
+
+/* When there are so many handles that the tree would be built again anyway, they are not kept. */
+void SpatialIndex::touch(Handle h) {
+	if (touchedAll) return;
+	if (int(touched.size()) > changedLimit + liveEntries) touchAll();
+	else touched.push_back(h);
+}
+
+void SpatialIndex::touchAll() {
+	touchedAll = true;
+	touched.clear();
+}
+
+/* Every changed polygon leaves the tree (its entry becomes stale) or its previous place in the list of changed polygons,
+and is added again to that list with its current bounding box, if it still exists and has vertices. */
+void SpatialIndex::update(const PolygonStore& store) {
+	if (touchedAll) {
+		build(store);
+		return;
+	}
+	inTree.resize(store.size(), -1);
+	inChanged.resize(store.size(), -1);
+	for (Handle h : touched) {
+		if (inTree[h] >= 0) {
+			stale[inTree[h]] = true;
+			inTree[h] = -1;
+			--liveEntries;
+		}
+		if (inChanged[h] >= 0) {
+			int position = inChanged[h];
+			inChanged[h] = -1;
+			if (position != int(changed.size()) - 1) {
+				changed[position] = changed.back();
+				inChanged[changed[position].handle] = position;
+			}
+			changed.pop_back();
+		}
+		if (not store.defined(h) or store.polygon(h).getVertices() == 0) continue;
+		Entry entry;
+		store.polygon(h).getBounds(entry.box.xmin, entry.box.xmax, entry.box.ymin, entry.box.ymax);
+		entry.handle = h;
+		inChanged[h] = changed.size();
+		changed.push_back(entry);
+	}
+	touched.clear();
+	if (changed.size() > max<size_t>(changedLimit, liveEntries/4)) build(store);
+}
+
+/* Extends the box [xmin, xmax] x [ymin, ymax] so that it contains the box [xmin2, xmax2] x [ymin2, ymax2]. */
+static void extend(double& xmin, double& xmax, double& ymin, double& ymax, double xmin2, double xmax2, double ymin2, double ymax2) {
+	xmin = min(xmin, xmin2);
+	xmax = max(xmax, xmax2);
+	ymin = min(ymin, ymin2);
+	ymax = max(ymax, ymax2);
+}
+
+/* Sort-Tile-Recursive packing of the items (with a "box"): they are sorted by the X coordinate of their center and split in vertical slices
+of about sqrt(number of groups) groups each; then, the items of every slice are sorted by the Y coordinate of their center.
+Consecutive items in the resulting order form the groups of "nodeCapacity" items. */
+template <typename Item>
+static void packItems(vector<Item>& items) {
+	long groups = (items.size() + nodeCapacity - 1)/nodeCapacity;
+	long sliceSize = long(ceil(sqrt(double(groups))))*nodeCapacity;
+	auto centerX = [](const Item& a, const Item& b) { return a.box.xmin + a.box.xmax < b.box.xmin + b.box.xmax; };
+	auto centerY = [](const Item& a, const Item& b) { return a.box.ymin + a.box.ymax < b.box.ymin + b.box.ymax; };
+	sort(items.begin(), items.end(), centerX);
+	for (long first = 0; first < long(items.size()); first += sliceSize) {
+		sort(items.begin() + first, items.begin() + min<long>(first + sliceSize, items.size()), centerY);
+	}
+}
+
+/* Returns the nodes that group the given items, in groups of "nodeCapacity". */
+template <typename Item, typename Node>
+static vector<Node> groupItems(const vector<Item>& items) {
+	vector<Node> nodes;
+	for (int first = 0; first < int(items.size()); first += nodeCapacity) {
+		Node node;
+		node.first = first;
+		node.count = min<int>(nodeCapacity, items.size() - first);
+		node.box = items[first].box;
+		for (int i = first + 1; i < first + node.count; ++i) {
+			const auto& box = items[i].box;
+			extend(node.box.xmin, node.box.xmax, node.box.ymin, node.box.ymax, box.xmin, box.xmax, box.ymin, box.ymax);
+		}
+		nodes.push_back(node);
+	}
+	return nodes;
+}
+
+/* The entries are packed to make the leaves, and the nodes of every level are packed in turn to make the level above them, until there is only one node.
+Reordering the nodes of a level does not change their children, which are already in place. */
+void SpatialIndex::build(const PolygonStore& store) {
+	entries.clear();
+	for (Handle h = 0; h < store.size(); ++h) {
+		if (not store.defined(h) or store.polygon(h).getVertices() == 0) continue;
+		Entry entry;
+		store.polygon(h).getBounds(entry.box.xmin, entry.box.xmax, entry.box.ymin, entry.box.ymax);
+		entry.handle = h;
+		entries.push_back(entry);
+	}
+	packItems(entries);
+	levels.clear();
+	if (not entries.empty()) levels.push_back(groupItems<Entry, Node>(entries));
+	while (not levels.empty() and levels.back().size() > 1) {
+		packItems(levels.back());
+		levels.push_back(groupItems<Node, Node>(levels.back()));
+	}
+
+	stale.assign(entries.size(), false);
+	liveEntries = entries.size();
+	inTree.assign(store.size(), -1);
+	for (int i = 0; i < liveEntries; ++i) inTree[entries[i].handle] = i;
+	inChanged.assign(store.size(), -1);
+	changed.clear();
+	touched.clear();
+	touchedAll = false;
+}
+
+/* Returns "true" if the two boxes have some point in common. */
+template <typename Box>
+static bool overlap(const Box& a, const Box& b) {
+	return a.xmin <= b.xmax and b.xmin <= a.xmax and a.ymin <= b.ymax and b.ymin <= a.ymax;
+}
+
+/* Depth-first search from the root, with an explicit stack of (level, node) pairs. */
+template <typename Visit>
+void SpatialIndex::search(const Box& window, Visit visit) const {
+	for (const Entry& entry : changed) if (overlap(entry.box, window)) visit(entry);
+	if (levels.empty()) return;
+	vector<pair<int, int>> stack = {{int(levels.size()) - 1, 0}};
+	while (not stack.empty()) {
+		int level = stack.back().first;
+		const Node& node = levels[level][stack.back().second];
+		stack.pop_back();
+		if (not overlap(node.box, window)) continue;
+		for (int i = node.first; i < node.first + node.count; ++i) {
+			if (level > 0) stack.push_back({level - 1, i});
+			else if (not stale[i] and overlap(entries[i].box, window)) visit(entries[i]);
+		}
+	}
+}
+
+void SpatialIndex::sortedNames(const PolygonStore& store, const vector<Handle>& handles, vector<string>& names) {
+	names.clear();
+	for (Handle h : handles) names.push_back(store.name(h));
+	sort(names.begin(), names.end());
+}
+
+void SpatialIndex::containing(const PolygonStore& store, const Point& p, vector<string>& names) const {
+	vector<Handle> found;
+	Box point = {p.get_x(), p.get_x(), p.get_y(), p.get_y()};
+	search(point, [&](const Entry& entry) {
+		if (store.polygon(entry.handle).pointPosition(p) != Outside) found.push_back(entry.handle);
+	});
+	sortedNames(store, found, names);
+}
+
+void SpatialIndex::overlapping(const PolygonStore& store, double xmin, double xmax, double ymin, double ymax, vector<string>& names) const {
+	vector<Handle> found;
+	Box window = {xmin, xmax, ymin, ymax};
+	search(window, [&](const Entry& entry) {
+		if (store.polygon(entry.handle).overlapsBox(xmin, xmax, ymin, ymax)) found.push_back(entry.handle);
+	});
+	sortedNames(store, found, names);
+}
+
+/* Returns the distance from the point "p" to the box (zero if it is inside). */
+template <typename Box>
+static double boxDistance(const Box& box, const Point& p) {
+	double dx = max(0.0, max(box.xmin - p.get_x(), p.get_x() - box.xmax));
+	double dy = max(0.0, max(box.ymin - p.get_y(), p.get_y() - box.ymax));
+	return sqrt(dx*dx + dy*dy);
+}
+
+/* Element of the queue of the nearest polygons search: a node (level >= 0), an entry whose polygon has not been measured yet (level -1)
+or a measured polygon (level -2), with a lower bound of its distance (the exact distance for the measured polygons). */
+struct Candidate {
+	double distance;
+	int level;
+	int index;
+	Handle handle;
+	const string* name;
+
+	/* The queue gives first the lowest distance; for the same distance, the nodes and unmeasured entries go before the measured polygons,
+	which are sorted by name. */
+	bool operator< (const Candidate& c) const {
+		if (distance != c.distance) return distance > c.distance;
+		if ((level == -2) != (c.level == -2)) return level == -2;
+		if (level == -2) return *name > *c.name;
+		return false;
+	}
+};
+
+/* Best-first search: the elements are taken from the queue by increasing distance. Since the distance of a node or an unmeasured entry is a lower bound
+of the distances of the polygons below it, when a measured polygon leaves the queue no polygon that is still to be found can be nearer. */
+void SpatialIndex::nearest(const PolygonStore& store, const Point& p, int k, vector<string>& names) const {
+	names.clear();
+	if (k <= 0) return;
+	priority_queue<Candidate> queue;
+	for (int i = 0; i < int(changed.size()); ++i) queue.push({boxDistance(changed[i].box, p), -1, i, changed[i].handle, &store.name(changed[i].handle)});
+	if (not levels.empty()) queue.push({boxDistance(levels.back()[0].box, p), int(levels.size()) - 1, 0, noHandle, nullptr});
+	while (not queue.empty() and int(names.size()) < k) {
+		Candidate c = queue.top();
+		queue.pop();
+		if (c.level == -2) names.push_back(*c.name);
+		else if (c.level == -1) queue.push({store.polygon(c.handle).distanceTo(p), -2, c.index, c.handle, c.name});
+		else {
+			const Node& node = levels[c.level][c.index];
+			for (int i = node.first; i < node.first + node.count; ++i) {
+				if (c.level > 0) queue.push({boxDistance(levels[c.level - 1][i].box, p), c.level - 1, i, noHandle, nullptr});
+				else if (not stale[i]) queue.push({boxDistance(entries[i].box, p), -1, i, entries[i].handle, &store.name(entries[i].handle)});
+			}
+		}
+	}
+}
@@ -0,0 +1,88 @@
+#ifndef SpatialIndex_hh
+#define SpatialIndex_hh
+#include <string>
+#include <vector>
+#include "ConvexPolygon.hh"
+#include "PolygonStore.hh"
+using namespace std;
+
+/* The SpatialIndex class answers spatial queries over a set of named polygons: which ones contain a point, which ones overlap a window
+and which ones are the nearest to a point. It is an R-tree over the bounding boxes of the polygons, bulk-loaded with Sort-Tile-Recursive packing,
+and the candidates that it finds are checked with the exact tests of the ConvexPolygon class.
+The index keeps the handles of the polygons, and it does not watch them: the polygons that change must be reported with "touch",
+and the index is brought up to date by "update".
+The changed polygons are kept apart, in a small list that is always checked, until there are enough of them to build the tree again. */
+
+class SpatialIndex {
+
+public:
+	/** Constructor. */
+	SpatialIndex();
+
+	/** Reports that the polygon with the handle "h" may have been created or modified. */
+	void touch(Handle h);
+
+	/** Reports that any polygon may have been created or modified. */
+	void touchAll();
+
+	/** Brings the index up to date with the polygons of "store", which must be the same store as in the previous calls. */
+	void update(const PolygonStore& store);
+
+	/** Stores in "names" the names of the polygons that contain the point "p" (or have it on their boundary), lexicographically sorted. */
+	void containing(const PolygonStore& store, const Point& p, vector<string>& names) const;
+
+	/** Stores in "names" the names of the polygons that have some point in common with the window [xmin, xmax] x [ymin, ymax], lexicographically sorted. */
+	void overlapping(const PolygonStore& store, double xmin, double xmax, double ymin, double ymax, vector<string>& names) const;
+
+	/** Stores in "names" the names of the "k" polygons nearest to the point "p" (fewer if there are not so many polygons), from the nearest one.
+		The distance is zero for the polygons that contain the point, and the ties are sorted by name. */
+	void nearest(const PolygonStore& store, const Point& p, int k, vector<string>& names) const;
+
+private:
+
+	/** Axis-aligned box. */
+	struct Box {
+		double xmin, xmax, ymin, ymax;
+	};
+
+	/** Polygon with its bounding box. */
+	struct Entry {
+		Box box;
+		Handle handle;
+	};
+
+	/** Node of the tree, with its bounding box and the range of its children in the level below (in "entries" for the leaves). */
+	struct Node {
+		Box box;
+		int first, count;
+	};
+
+	/** Entries of the tree, in the order of the leaves, and "true" for the ones whose polygon has changed since the tree was built, with the number of the other ones. */
+	vector<Entry> entries;
+	vector<char> stale;
+	int liveEntries;
+
+	/** Levels of the tree, from the leaves ("levels[0]") to the root (the only node of the last level). */
+	vector<vector<Node>> levels;
+
+	/** Position of every polygon, by handle, in "entries" or in "changed", the polygons that have changed since the tree was built ("-1" if it is not there). */
+	vector<int> inTree;
+	vector<int> inChanged;
+	vector<Entry> changed;
+
+	/** Handles reported by "touch" and whether "touchAll" has been called since the last update. */
+	vector<Handle> touched;
+	bool touchedAll;
+
+	/** Builds the tree with all the polygons that have vertices. */
+	void build(const PolygonStore& store);
+
+	/** Stores in "names" the identifiers of the given handles, lexicographically sorted. */
+	static void sortedNames(const PolygonStore& store, const vector<Handle>& handles, vector<string>& names);
+
+	/** Calls "visit" with the entries (in the tree or changed) whose box overlaps "window". */
+	template <typename Visit>
+	void search(const Box& window, Visit visit) const;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "Stats.hh"
+#include <memory>
+#include <mutex>
+#include <cstdlib>
+#include <algorithm>
+#include <cinttypes>
+using namespace std;
+
+atomic<bool> statsEnabled(false);
+
+Histogram::Histogram() {
+	reset();
+}
+
+/* The values are only counted, so the order of the operations on different counters does not matter. The largest value is kept with
+a compare-and-swap loop, which stops as soon as it sees a value that is not lower. */
+void Histogram::record(uint64_t value) {
+	counts[bucketOf(value)].fetch_add(1, memory_order_relaxed);
+	added.fetch_add(1, memory_order_relaxed);
+	total.fetch_add(value, memory_order_relaxed);
+	uint64_t current = largest.load(memory_order_relaxed);
+	while (current < value and not largest.compare_exchange_weak(current, value, memory_order_relaxed));
+}
+
+uint64_t Histogram::count() const {
+	return added.load(memory_order_relaxed);
+}
+
+uint64_t Histogram::sum() const {
+	return total.load(memory_order_relaxed);
+}
+
+uint64_t Histogram::max() const {
+	return largest.load(memory_order_relaxed);
+}
+
+/* The buckets are added up until they hold the wanted number of values (rounded up, and at least one). The counters are read one by one,
+so their total may be lower than "count" when other threads are recording values: then, the largest value is given. */
+uint64_t Histogram::percentile(double q) const {
+	uint64_t n = count();
+	if (n == 0) return 0;
+	uint64_t wanted = uint64_t(q*n);
+	if (wanted < q*n) ++wanted;
+	if (wanted == 0) wanted = 1;
+	uint64_t seen = 0;
+	for (int i = 0; i < buckets; ++i) {
+		seen += counts[i].load(memory_order_relaxed);
+		if (seen >= wanted) return min(highest(i), max());
+	}
+	return max();
+}
+
+void Histogram::reset() {
+	for (int i = 0; i < buckets; ++i) counts[i].store(0, memory_order_relaxed);
+	added.store(0, memory_order_relaxed);
+	total.store(0, memory_order_relaxed);
+	largest.store(0, memory_order_relaxed);
+}
+
+void Histogram::write(FILE* file) const {
+	fprintf(file, "count %" PRIu64 " sum %" PRIu64 " max %" PRIu64 "\n", count(), sum(), max());
+	for (int i = 0; i < buckets; ++i) {
+		uint64_t n = counts[i].load(memory_order_relaxed);
+		if (n > 0) fprintf(file, "  [%" PRIu64 ", %" PRIu64 "] %" PRIu64 "\n", lowest(i), highest(i), n);
+	}
+}
+
+/* The values below 16 have their own bucket. For larger values, the bucket is given by the position "e" of the highest bit that is set
+and by the three bits below it. */
+int Histogram::bucketOf(uint64_t value) {
+	if (value < 16) return value;
+	int e = 63 - __builtin_clzll(value);
+	return 16 + (e - 4)*8 + int((value >> (e - 3)) & 7);
+}
+
+uint64_t Histogram::lowest(int bucket) {
+	if (bucket < 16) return bucket;
+	int e = 4 + (bucket - 16)/8;
+	return uint64_t(8 + (bucket - 16)%8) << (e - 3);
+}
+
+uint64_t Histogram::highest(int bucket) {
+	if (bucket < 16) return bucket;
+	int e = 4 + (bucket - 16)/8;
+	return lowest(bucket) + ((uint64_t(1) << (e - 3)) - 1);
+}
+
+/* The metrics are kept in a list that is never destroyed, since they may be used until the very end of the program (by the workers of a pool
+that is destroyed at exit, or by the function that writes them at exit). */
+struct Registry {
+	mutex lock;
+	vector<unique_ptr<Metric>> metrics;
+};
+
+static Registry& registry() {
+	static Registry* instance = new Registry();
+	return *instance;
+}
+
+Metric& metric(const string& name) {
+	Registry& r = registry();
+	lock_guard<mutex> guard(r.lock);
+	for (auto& m : r.metrics) if (m->name == name) return *m;
+	r.metrics.emplace_back(new Metric());
+	r.metrics.back()->name = name;
+	return *r.metrics.back();
+}
+
+vector<Metric*> allMetrics() {
+	Registry& r = registry();
+	lock_guard<mutex> guard(r.lock);
+	vector<Metric*> metrics;
+	for (auto& m : r.metrics) metrics.push_back(m.get());
+	return metrics;
+}
+
+void writeStats(FILE* file) {
+	for (Metric* m : allMetrics()) {
+		if (m->time.count() > 0) {
+			fprintf(file, "%s time_ns ", m->name.c_str());
+			m->time.write(file);
+		}
+		if (m->vertices.count() > 0) {
+			fprintf(file, "%s vertices ", m->name.c_str());
+			m->vertices.write(file);
+		}
+		if (m->discarded.count() > 0) {
+			fprintf(file, "%s discarded ", m->name.c_str());
+			m->discarded.write(file);
+		}
+	}
+}
+
+static void writeStatsAtExit() {
+	writeStats(stderr);
+}
+
+void initStats() {
+	const char* value = getenv("CONVEXPOLYGON_STATS");
+	if (value == nullptr or value[0] == '\0') return;
+	statsEnabled = true;
+	atexit(writeStatsAtExit);
+}
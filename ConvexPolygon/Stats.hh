@@ -0,0 +1,118 @@
+#ifndef Stats_hh
+#define Stats_hh
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+using namespace std;
+
+/* Instrumentation of the calculator: histograms of the time taken by every command and by the main operations of the ConvexPolygon class,
+and of the number of vertices that those operations receive. The values are counted in buckets whose width grows with the value (eight buckets
+between consecutive powers of two), so a percentile is known within 12.5% with a fixed amount of memory, and recording a value only adds one
+to a counter. The counters are atomic, so the commands of a batch and the workers of an operation may record values at the same time.
+Nothing is recorded while the statistics are disabled, and then measuring an operation only costs the test of a flag.
+They are enabled by the "stats on" command or by the CONVEXPOLYGON_STATS environment variable, which also writes all the histograms
+to the standard error output at exit. */
+
+class Histogram {
+
+public:
+	/** Number of buckets: one for every value below 16 and eight for every power of two from 16 to 2^63. */
+	static const int buckets = 16 + 60*8;
+
+	/** Constructor. The histogram is empty. */
+	Histogram();
+
+	/** Counts a value. */
+	void record(uint64_t value);
+
+	/** Returns the number of recorded values, their sum and the largest of them. */
+	uint64_t count() const;
+	uint64_t sum() const;
+	uint64_t max() const;
+
+	/** Returns a value such that a fraction "q" of the recorded values are not above it: the upper end of the bucket where the fraction
+		is reached, or the largest value if it is lower. Returns "0" if the histogram is empty. */
+	uint64_t percentile(double q) const;
+
+	/** Empties the histogram. Values recorded at the same time may be lost. */
+	void reset();
+
+	/** Writes the number of values, their sum and maximum, and the range and number of values of every bucket that is not empty. */
+	void write(FILE* file) const;
+
+	/** Returns the bucket of a value and the lowest and highest values of a bucket. */
+	static int bucketOf(uint64_t value);
+	static uint64_t lowest(int bucket);
+	static uint64_t highest(int bucket);
+
+private:
+	atomic<uint64_t> counts[buckets];
+	atomic<uint64_t> total;
+	atomic<uint64_t> added;
+	atomic<uint64_t> largest;
+};
+
+/** Statistics of a command or an operation: its time in nanoseconds, the number of vertices of its input (only for the operations) 
+	and the number of them that it discards (only for the operations that filter their input). */
+struct Metric {
+	string name;
+	Histogram time;
+	Histogram vertices;
+	Histogram discarded;
+};
+
+/** Returns the metric with the given name, which is created the first time. It is never destroyed. */
+Metric& metric(const string& name);
+
+/** Returns all the metrics, in the order in which they were created. */
+vector<Metric*> allMetrics();
+
+/** Whether the statistics are enabled. */
+extern atomic<bool> statsEnabled;
+
+inline bool statsOn() {
+	return statsEnabled.load(memory_order_relaxed);
+}
+
+/** Enables the statistics if the CONVEXPOLYGON_STATS environment variable is set, and then writes them to the standard error output at exit. */
+void initStats();
+
+/** Writes all the histograms of the metrics that have some value. */
+void writeStats(FILE* file);
+
+/** The Timer class records in a metric the time from its construction to its destruction, if the statistics are enabled when it is built.
+	The number of vertices of the input, if given, is recorded too. */
+class Timer {
+
+public:
+	explicit Timer(Metric& metric) : _metric(statsOn() ? &metric : nullptr) {
+		if (_metric != nullptr) _start = chrono::steady_clock::now();
+	}
+
+	Timer(Metric& metric, uint64_t vertices) : Timer(metric) {
+		if (_metric != nullptr) _metric->vertices.record(vertices);
+	}
+
+	/** Returns "true" if the time is being measured. */
+	bool active() const {
+		return _metric != nullptr;
+	}
+
+	~Timer() {
+		if (_metric == nullptr) return;
+		auto elapsed = chrono::steady_clock::now() - _start;
+		_metric->time.record(chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+	}
+
+	Timer(const Timer&) = delete;
+	Timer& operator= (const Timer&) = delete;
+
+private:
+	Metric* _metric;
+	chrono::steady_clock::time_point _start;
+};
+
+#endif
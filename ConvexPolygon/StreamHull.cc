@@ -0,0 +1,83 @@
+#include "StreamHull.hh"
+#include "Parallel.hh"
+#include <vector>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std;
+
+/* The points are read directly into the memory of a vector of points, so the coordinates must be stored as in the file. */
+static_assert(sizeof(Point) == 2*sizeof(double), "the coordinates of the points must be contiguous");
+
+static bool isLittleEndian() {
+	uint16_t one = 1;
+	unsigned char first;
+	memcpy(&first, &one, 1);
+	return first == 1;
+}
+
+/* "pread" may read less bytes than asked (or be interrupted), so it is called until all of them have been read.
+Every thread reads at its own offset, so the threads do not share a position in the file. */
+static bool readFully(int fd, char* buffer, uint64_t size, uint64_t offset) {
+	while (size > 0) {
+		ssize_t read = pread(fd, buffer, size, offset);
+		if (read < 0 and errno == EINTR) continue;
+		if (read <= 0) return false;
+		buffer += read;
+		size -= read;
+		offset += read;
+	}
+	return true;
+}
+
+/* The chunks are handed out in order by an atomic counter, so a thread that gets small hulls takes more chunks. The hull of a chunk is merged
+with the hull of the previous chunks of the thread in linear time, since both are convex. The buffer of every thread is only as big as a chunk. */
+StreamResult streamHull(const string& nameFile, long chunkPoints, int threads, ConvexPolygon& hull) {
+	if (not isLittleEndian()) return StreamWrongFormat;
+	int fd = open(nameFile.c_str(), O_RDONLY);
+	if (fd < 0) return StreamUnreadable;
+	struct stat info;
+	if (fstat(fd, &info) != 0 or not S_ISREG(info.st_mode)) {
+		close(fd);
+		return StreamUnreadable;
+	}
+	if (info.st_size % sizeof(Point) != 0) {
+		close(fd);
+		return StreamWrongFormat;
+	}
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	uint64_t points = info.st_size/sizeof(Point);
+	uint64_t chunks = (points + chunkPoints - 1)/chunkPoints;
+	threads = int(max<uint64_t>(1, min<uint64_t>(threads, chunks)));
+	atomic<uint64_t> nextChunk(0);
+	atomic<bool> failed(false);
+	vector<ConvexPolygon> partial(threads);
+	parallelFor(threads, [&](int t) {
+		vector<Point> buffer;
+		for (uint64_t c = nextChunk++; c < chunks and not failed; c = nextChunk++) {
+			uint64_t first = c*chunkPoints;
+			uint64_t size = min<uint64_t>(chunkPoints, points - first);
+			buffer.resize(size);
+			if (not readFully(fd, (char*)buffer.data(), size*sizeof(Point), first*sizeof(Point))) {
+				failed = true;
+				return;
+			}
+			ConvexPolygon chunk = ConvexPolygon::fromPoints(buffer);
+			partial[t] = partial[t].getUnion(partial[t], chunk);
+		}
+	});
+	close(fd);
+	if (failed) return StreamUnreadable;
+
+	vector<const ConvexPolygon*> hulls;
+	for (const ConvexPolygon& polygon : partial) hulls.push_back(&polygon);
+	hull = hull.getUnion(hulls);
+	return StreamOk;
+}
@@ -0,0 +1,24 @@
+#ifndef StreamHull_hh
+#define StreamHull_hh
+#include <string>
+#include "ConvexPolygon.hh"
+using namespace std;
+
+/* Convex hull of a file of points that may not fit in memory. The file is a raw sequence of points, without a header: the X and Y coordinates
+of every point, one after the other, as little-endian 64-bit doubles (16 bytes per point). It is read in chunks of a bounded number of points
+by several threads: every thread reads a chunk into its own buffer, builds its hull and merges it with the hull of its previous chunks,
+so only the buffers and the hulls are kept in memory, whatever the size of the file. The hulls of the threads are merged at the end. */
+
+/** Number of points of a chunk when no other one is given (512 KiB). */
+const long defaultChunkPoints = 1 << 15;
+
+/** Results of "streamHull". */
+enum StreamResult { StreamOk, StreamUnreadable, StreamWrongFormat };
+
+/** Stores in "hull" the convex hull of the points of a raw file, read in chunks of "chunkPoints" points by "threads" threads.
+	Returns "StreamUnreadable" if the file cannot be opened or read, and "StreamWrongFormat" if its size is not a multiple of 16 bytes
+	(or the processor is not little-endian). In both cases, "hull" does not change.
+	Pre: chunkPoints > 0. */
+StreamResult streamHull(const string& nameFile, long chunkPoints, int threads, ConvexPolygon& hull);
+
+#endif
@@ -0,0 +1,93 @@
+#include "TextLoader.hh"
+#include "FastParse.hh"
+#include "Parallel.hh"
+#include <vector>
+#include <atomic>
+#include <cctype>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std;
+
+/* Chunks have about this number of bytes (they are extended up to the end of their last line). */
+static const long chunkSize = 1 << 22;
+
+/* Number of chunks per thread that are parsed before handing their polygons back. */
+static const int chunksPerThread = 4;
+
+/* Given a line (without its end of line character), it reads the name and the points, in the same way as the polygon command:
+the points are read in pairs of coordinates until one of them cannot be read. */
+static void parseLine(const char* p, const char* end, TextPolygon& result) {
+	const char* word;
+	size_t size;
+	parseWord(p, end, word, size);
+	result.name.assign(word, size);
+	result.validName = not (size > 0 and isdigit(word[0]));
+	if (not result.validName) return;
+
+	vector<Point> points;
+	double x, y;
+	while (parseDouble(p, end, x) and parseDouble(p, end, y)) points.push_back(Point(x, y));
+	result.polygon = ConvexPolygon::fromPoints(points);
+}
+
+/* Splits the chunk [begin, end) in lines and parses every one of them. As "getline" does, there is no line after the last end of line character. */
+static void parseChunk(const char* begin, const char* end, vector<TextPolygon>& results) {
+	const char* line = begin;
+	while (line != end) {
+		const char* lineEnd = line;
+		while (lineEnd != end and *lineEnd != '\n') ++lineEnd;
+		results.push_back(TextPolygon());
+		parseLine(line, lineEnd, results.back());
+		line = (lineEnd == end) ? end : lineEnd + 1;
+	}
+}
+
+/* First, the file is mapped in memory and the positions where the chunks start are computed, moving every boundary to the start of the next line.
+Then, the chunks are processed in windows: the workers take the chunks of the window one by one (the next free chunk is given by an atomic counter),
+and when all of them are finished, the polygons are handed back chunk by chunk, in order. */
+bool loadText(const string& nameFile, const function<void(TextPolygon&)>& handle) {
+	int fd = open(nameFile.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		return false;
+	}
+	long size = info.st_size;
+	if (size == 0) {
+		close(fd);
+		return true;
+	}
+	void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (address == MAP_FAILED) return false;
+	const char* text = (const char*)address;
+	const char* textEnd = text + size;
+
+	vector<const char*> bounds = {text};
+	while (bounds.back() != textEnd) {
+		const char* next = bounds.back() + min(chunkSize, textEnd - bounds.back());
+		while (next != textEnd and *(next - 1) != '\n') ++next;
+		bounds.push_back(next);
+	}
+	int chunks = bounds.size() - 1;
+
+	int threads = hardwareThreads();
+	int window = threads*chunksPerThread;
+	for (int first = 0; first < chunks; first += window) {
+		int last = min(chunks, first + window);
+		vector<vector<TextPolygon>> results(last - first);
+		atomic<int> next(first);
+		parallelFor(min(threads, last - first), [&](int) {
+			for (int c = next++; c < last; c = next++) parseChunk(bounds[c], bounds[c+1], results[c - first]);
+		});
+		for (vector<TextPolygon>& chunk : results) {
+			for (TextPolygon& loaded : chunk) handle(loaded);
+		}
+	}
+
+	munmap(address, size);
+	return true;
+}
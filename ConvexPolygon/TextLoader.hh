@@ -0,0 +1,23 @@
+#ifndef TextLoader_hh
+#define TextLoader_hh
+#include <string>
+#include <functional>
+#include "ConvexPolygon.hh"
+using namespace std;
+
+/* Parallel loader of text files with one polygon per line (the name followed by the coordinates of its points, as in the polygon command).
+The file is memory-mapped and split in chunks of whole lines. A pool of workers parses the chunks and builds the convex hulls,
+and the polygons are handed back in the same order as they appear in the file. Only a bounded window of chunks is kept in memory at once. */
+
+/** Polygon read from a line of a text file. */
+struct TextPolygon {
+	string name;
+	bool validName;           // "false" if the name starts with a digit (then, the polygon is empty).
+	ConvexPolygon polygon;
+};
+
+/** Reads the polygons stored in the text file "nameFile" and calls "handle" with each one of them, in the same order as in the file.
+	Returns "false" if the file cannot be opened. */
+bool loadText(const string& nameFile, const function<void(TextPolygon&)>& handle);
+
+#endif
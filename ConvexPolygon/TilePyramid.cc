@@ -0,0 +1,229 @@
+#include "TilePyramid.hh"
+#include "Raster.hh"
+#include "Parallel.hh"
+#include <unordered_map>
+#include <fstream>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <cerrno>
+#include <algorithm>
+#include <sys/stat.h>
+using namespace std;
+
+/* Name of the manifest, in the directory of the pyramid. Every line has the level and position of a tile, its fingerprint (in hexadecimal)
+and "1" if no polygon is visible in it, so that it has no file. */
+static const string manifestName = "tiles.manifest";
+
+/* Polygon drawn in the pyramid. */
+struct TilePolygon {
+	const VertexArray* points;
+	double xmin, xmax, ymin, ymax;
+	unsigned char rgba[4];
+	uint64_t fingerprint;
+};
+
+/* Tile of the pyramid, with the polygons whose bounding box overlaps it (positions in the vector of TilePolygons, in drawing order). */
+struct Tile {
+	int z, x, y;
+	vector<int> polygons;
+	uint64_t fingerprint;
+	bool blank;
+};
+
+/* What the manifest says about a tile. */
+struct ManifestEntry {
+	int z, x, y;
+	uint64_t fingerprint;
+	bool blank;
+};
+
+/* Adds a value to a fingerprint. The value is mixed first, so that small changes of it change many bits of the fingerprint. */
+static uint64_t combine(uint64_t fingerprint, uint64_t value) {
+	value *= 0xff51afd7ed558ccdull;
+	value ^= value >> 33;
+	fingerprint ^= value;
+	fingerprint *= 0xc4ceb9fe1a85ec53ull;
+	return fingerprint ^ (fingerprint >> 29);
+}
+
+static uint64_t bits(double value) {
+	uint64_t result;
+	memcpy(&result, &value, sizeof(result));
+	return result;
+}
+
+/* Key of a tile in the hash tables (the levels and positions are below 2^24). */
+static uint64_t tileKey(int z, int x, int y) {
+	return uint64_t(z) << 48 | uint64_t(x) << 24 | uint64_t(y);
+}
+
+static string tilePath(const string& directory, int z, int x, int y) {
+	return directory + "/" + to_string(z) + "/" + to_string(x) + "/" + to_string(y) + ".png";
+}
+
+static bool makeDirectory(const string& path) {
+	return mkdir(path.c_str(), 0777) == 0 or errno == EEXIST;
+}
+
+static bool fileExists(const string& path) {
+	struct stat status;
+	return stat(path.c_str(), &status) == 0;
+}
+
+static unordered_map<uint64_t, ManifestEntry> readManifest(const string& directory) {
+	unordered_map<uint64_t, ManifestEntry> entries;
+	ifstream in(directory + "/" + manifestName);
+	ManifestEntry entry;
+	while (in >> entry.z >> entry.x >> entry.y >> hex >> entry.fingerprint >> dec >> entry.blank) {
+		entries[tileKey(entry.z, entry.x, entry.y)] = entry;
+	}
+	return entries;
+}
+
+/* The manifest is written to a temporary file that replaces the old one at the end, so it is never left half written. */
+static bool writeManifest(const string& directory, const vector<Tile>& tiles) {
+	string name = directory + "/" + manifestName;
+	string temporary = name + ".tmp";
+	{
+		ofstream out(temporary);
+		for (const Tile& tile : tiles) {
+			out << tile.z << " " << tile.x << " " << tile.y << " " << hex << tile.fingerprint << dec << " " << tile.blank << "\n";
+		}
+		if (not out) return false;
+	}
+	return rename(temporary.c_str(), name.c_str()) == 0;
+}
+
+/* The vertices of every polygon are moved to the pixels of the tile, clipped to the tile with a margin of one pixel (so that the edges made by the clipping
+are not drawn), and drawn filled. */
+static void renderTile(const Tile& tile, const vector<TilePolygon>& drawn, double left, double top, double side, Raster& raster, RasterScratch& scratch,
+                       vector<double>& xs, vector<double>& ys, vector<double>& clippedX, vector<double>& clippedY) {
+	double size = side/(1 << tile.z);
+	double tileLeft = left + tile.x*size;
+	double tileBottom = top - (tile.y + 1)*size;
+	double scale = tileSize/size;
+	for (int k : tile.polygons) {
+		const VertexArray& points = *drawn[k].points;
+		int n = points.size();
+		xs.resize(n);
+		ys.resize(n);
+		for (int i = 0; i < n; ++i) {
+			xs[i] = (points.xs()[i] - tileLeft)*scale;
+			ys[i] = (points.ys()[i] - tileBottom)*scale;
+		}
+		int m = clipConvex(xs.data(), ys.data(), n, -1, tileSize + 1, -1, tileSize + 1, clippedX, clippedY);
+		raster.drawConvex(clippedX.data(), clippedY.data(), m, drawn[k].rgba, true, 0, tileSize, scratch);
+	}
+}
+
+/* The polygons are assigned to the tiles of every level that their bounding box overlaps. The fingerprint of a tile combines the square covered by
+the pyramid, the place of the tile and the fingerprints of its polygons, so it changes when anything that it shows may have changed.
+The tiles that have to be drawn are split between the threads, which take them one by one. */
+bool renderTiles(const vector<const ConvexPolygon*>& polygons, const vector<array<unsigned char, 4>>& colors,
+                 const string& directory, int levels, TileCounts& counts) {
+	counts = {0, 0, 0};
+	vector<TilePolygon> drawn;
+	for (int k = 0; k < int(polygons.size()); ++k) {
+		const ConvexPolygon& polygon = *polygons[k];
+		if (polygon.getVertices() == 0) continue;
+		TilePolygon p;
+		p.points = &polygon.getPoints();
+		polygon.getBounds(p.xmin, p.xmax, p.ymin, p.ymax);
+		memcpy(p.rgba, colors[k].data(), 4);
+		p.fingerprint = combine(0, p.points->size());
+		for (int i = 0; i < p.points->size(); ++i) {
+			p.fingerprint = combine(p.fingerprint, bits(p.points->xs()[i]));
+			p.fingerprint = combine(p.fingerprint, bits(p.points->ys()[i]));
+		}
+		for (int c = 0; c < 4; ++c) p.fingerprint = combine(p.fingerprint, p.rgba[c]);
+		drawn.push_back(p);
+	}
+
+	/* Smallest square that contains all the polygons (of side 1 if they are a single point). */
+	double left = 0, top = 0, side = 1;
+	if (not drawn.empty()) {
+		double xmin = drawn[0].xmin, xmax = drawn[0].xmax, ymin = drawn[0].ymin, ymax = drawn[0].ymax;
+		for (const TilePolygon& p : drawn) {
+			xmin = min(xmin, p.xmin);
+			xmax = max(xmax, p.xmax);
+			ymin = min(ymin, p.ymin);
+			ymax = max(ymax, p.ymax);
+		}
+		left = xmin;
+		top = ymax;
+		side = max(xmax - xmin, ymax - ymin);
+		if (side == 0) side = 1;
+	}
+
+	vector<Tile> tiles;
+	for (int z = 0; z < levels; ++z) {
+		int count = 1 << z;
+		double size = side/count;
+		auto position = [&](double offset) { return max(0, min(count - 1, int(floor(offset/size)))); };
+		unordered_map<uint64_t, int> index;
+		for (int k = 0; k < int(drawn.size()); ++k) {
+			const TilePolygon& p = drawn[k];
+			for (int x = position(p.xmin - left); x <= position(p.xmax - left); ++x) {
+				for (int y = position(top - p.ymax); y <= position(top - p.ymin); ++y) {
+					auto it = index.find(tileKey(z, x, y));
+					if (it == index.end()) {
+						it = index.insert({tileKey(z, x, y), tiles.size()}).first;
+						tiles.push_back({z, x, y, {}, 0, false});
+					}
+					tiles[it->second].polygons.push_back(k);
+				}
+			}
+		}
+	}
+
+	unordered_map<uint64_t, ManifestEntry> manifest = readManifest(directory);
+	vector<int> changed;
+	for (int t = 0; t < int(tiles.size()); ++t) {
+		Tile& tile = tiles[t];
+		uint64_t fingerprint = combine(combine(combine(0, bits(left)), bits(top)), bits(side));
+		fingerprint = combine(combine(combine(combine(fingerprint, tileSize), tile.z), tile.x), tile.y);
+		for (int k : tile.polygons) fingerprint = combine(fingerprint, drawn[k].fingerprint);
+		tile.fingerprint = fingerprint;
+		uint64_t key = tileKey(tile.z, tile.x, tile.y);
+		auto entry = manifest.find(key);
+		if (entry != manifest.end() and entry->second.fingerprint == fingerprint
+		    and (entry->second.blank or fileExists(tilePath(directory, tile.z, tile.x, tile.y)))) {
+			tile.blank = entry->second.blank;
+			++counts.unchanged;
+		} else changed.push_back(t);
+		if (entry != manifest.end()) manifest.erase(entry);
+	}
+	for (const auto& entry : manifest) {
+		const ManifestEntry& old = entry.second;
+		if (not old.blank and remove(tilePath(directory, old.z, old.x, old.y).c_str()) == 0) ++counts.removed;
+	}
+
+	if (not makeDirectory(directory)) return false;
+	for (int t : changed) {
+		const Tile& tile = tiles[t];
+		string level = directory + "/" + to_string(tile.z);
+		if (not makeDirectory(level) or not makeDirectory(level + "/" + to_string(tile.x))) return false;
+	}
+
+	atomic<int> next(0);
+	atomic<bool> written(true);
+	parallelFor(min<int>(hardwareThreads(), changed.size()), [&](int) {
+		RasterScratch scratch;
+		vector<double> xs, ys, clippedX, clippedY;
+		for (int i = next++; i < int(changed.size()); i = next++) {
+			Tile& tile = tiles[changed[i]];
+			Raster raster(tileSize, tileSize);
+			renderTile(tile, drawn, left, top, side, raster, scratch, xs, ys, clippedX, clippedY);
+			string path = tilePath(directory, tile.z, tile.x, tile.y);
+			tile.blank = raster.blank();
+			if (tile.blank) remove(path.c_str());
+			else if (not raster.writePng(path)) written = false;
+		}
+	});
+	if (not written) return false;
+	counts.rendered = changed.size();
+	return writeManifest(directory, tiles);
+}
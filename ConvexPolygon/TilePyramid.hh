@@ -0,0 +1,35 @@
+#ifndef TilePyramid_hh
+#define TilePyramid_hh
+#include <string>
+#include <vector>
+#include <array>
+#include "ConvexPolygon.hh"
+using namespace std;
+
+/* A tile pyramid shows a set of polygons at several zoom levels, as square PNG tiles stored in "directory/z/x/y.png".
+The level z has 2^z x 2^z tiles that cover the smallest square that contains all the polygons, aligned with its top left corner:
+x grows to the right and y grows downwards. Every tile is drawn with the polygons whose bounding box overlaps it, filled and clipped to the tile,
+and the tiles where no polygon is visible are not written. The tiles are drawn in parallel.
+The pyramid is updated incrementally: a manifest in the directory keeps a fingerprint of what every tile shows (its place and the vertices
+and colors of its polygons, in order), and only the tiles whose fingerprint has changed are drawn again. The tiles that are no longer part
+of the pyramid are removed. */
+
+/** Size of the tiles, in pixels. */
+const int tileSize = 256;
+
+/** Largest number of levels of a pyramid. */
+const int maxTileLevels = 12;
+
+/** Numbers of tiles drawn again, kept because they had not changed, and removed by "renderTiles". */
+struct TileCounts {
+	int rendered, unchanged, removed;
+};
+
+/** Brings the pyramid of the levels 0 ... levels - 1 in "directory" up to date with the given polygons, drawn in that order with their colors
+	(red, green, blue and alpha values from 0 to 255), and stores in "counts" what has been done.
+	Returns "false" if the directories cannot be created or a tile or the manifest cannot be written.
+	Pre: there is a color for every polygon, and 1 <= levels <= maxTileLevels. */
+bool renderTiles(const vector<const ConvexPolygon*>& polygons, const vector<array<unsigned char, 4>>& colors,
+                 const string& directory, int levels, TileCounts& counts);
+
+#endif
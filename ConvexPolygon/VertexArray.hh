@@ -0,0 +1,241 @@
+#ifndef VertexArray_hh
+#define VertexArray_hh
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include "Point.hh"
+using namespace std;
+
+/* The VertexArray class stores the vertices of a polygon as two contiguous arrays, one with the X coordinates and the other with the Y coordinates,
+so that the loops over the vertices can be vectorized. The vertices are still read and written as Points.
+The arrays are usually owned by the VertexArray, but they can also be borrowed from external memory (for instance, a memory-mapped file),
+which is kept alive by the VertexArray and copied the first time that the vertices are modified.
+Most polygons are small (triangles, boxes), so the owned arrays of up to "inlineCapacity" vertices are stored inside the VertexArray itself,
+and memory is only allocated when there are more vertices. Then, both arrays go in the same block, the Y coordinates after the X ones.
+The blocks are reference counted: copies share the block of the original in O(1) time, and the block is copied before it is modified
+if another VertexArray still uses it (copy on write), so every copy behaves as an independent value.
+The methods are defined here so that they can be inlined. */
+
+class VertexArray {
+
+public:
+	/** Number of vertices that are stored without allocating memory. */
+	static const int inlineCapacity = 8;
+
+	/** Constructor. */
+	VertexArray() : _block(nullptr), _capacity(inlineCapacity), _size(0) { sync(); }
+
+	/** Constructor. Stores the given points, in the same order. */
+	explicit VertexArray(const vector<Point>& points) : VertexArray() {
+		assign(points.data(), points.size());
+	}
+
+	/** Constructor. Borrows the "size" coordinates stored in "xs" and "ys", which must stay valid while "owner" is alive. */
+	VertexArray(const double* xs, const double* ys, int size, shared_ptr<const void> owner)
+	:	_block(nullptr), _capacity(inlineCapacity), _xs(xs), _ys(ys), _size(size), _owner(owner) {}
+
+	/** Copy constructor. Blocks and borrowed arrays are shared, inside arrays are copied. */
+	VertexArray(const VertexArray& v) : VertexArray() {
+		*this = v;
+	}
+
+	/** Move constructor. */
+	VertexArray(VertexArray&& v) : VertexArray() {
+		*this = std::move(v);
+	}
+
+	/** Assignment. Blocks and borrowed arrays are shared, in O(1) time; inside arrays are copied. */
+	VertexArray& operator= (const VertexArray& v) {
+		if (this == &v) return *this;
+		if (v._owner) share(v, v._owner);
+		else copyFrom(v._xs, v._ys, v._size);
+		return *this;
+	}
+
+	/** Move assignment. Blocks and borrowed arrays are taken from "v", which is left empty. */
+	VertexArray& operator= (VertexArray&& v) {
+		if (this == &v) return *this;
+		if (v._owner) share(v, std::move(v._owner));
+		else copyFrom(v._xs, v._ys, v._size);
+		v.makeEmpty();
+		return *this;
+	}
+
+	/** Returns the number of vertices. */
+	int size() const { return _size; }
+
+	/** Returns "true" if there are no vertices. */
+	bool empty() const { return _size == 0; }
+
+	/** Returns the vertex in position "i". */
+	Point operator[] (int i) const { return Point(_xs[i], _ys[i]); }
+
+	/** Returns the X coordinate of the vertex in position "i". */
+	double x(int i) const { return _xs[i]; }
+
+	/** Returns the Y coordinate of the vertex in position "i". */
+	double y(int i) const { return _ys[i]; }
+
+	/** Returns the array with the X coordinates of all the vertices. */
+	const double* xs() const { return _xs; }
+
+	/** Returns the array with the Y coordinates of all the vertices. */
+	const double* ys() const { return _ys; }
+
+	/** Returns "true" if the coordinates are borrowed from external memory. */
+	bool borrowed() const { return _owner and _block == nullptr; }
+
+	/** Adds a vertex at the end. */
+	void push_back(const Point& p) {
+		own();
+		if (_size == _capacity) grow(2*_capacity);
+		ownedXs()[_size] = p.get_x();
+		ownedYs()[_size] = p.get_y();
+		++_size;
+	}
+
+	/** Reserves memory for "size" vertices. */
+	void reserve(int size) {
+		own();
+		if (size > _capacity) grow(size);
+	}
+
+	/** Replaces the vertices by the "size" given points, in the same order. */
+	void assign(const Point* points, int size) {
+		reset();
+		if (size > _capacity) grow(size);
+		double* x = ownedXs();
+		double* y = ownedYs();
+		for (int i = 0; i < size; ++i) {
+			x[i] = points[i].get_x();
+			y[i] = points[i].get_y();
+		}
+		_size = size;
+	}
+
+	/** Replaces the vertices in positions [first, last) by the point "p". The vertices after them are moved with a single memmove of each array. */
+	void splice(int first, int last, const Point& p) {
+		own();
+		int size = _size - (last - first) + 1;
+		if (size > _capacity) grow(max(size, 2*_capacity));
+		double* x = ownedXs();
+		double* y = ownedYs();
+		memmove(x + first + 1, x + last, (_size - last)*sizeof(double));
+		memmove(y + first + 1, y + last, (_size - last)*sizeof(double));
+		x[first] = p.get_x();
+		y[first] = p.get_y();
+		_size = size;
+	}
+
+	/** Keeps only the first "size" vertices ("size" must not be bigger than the number of vertices). */
+	void truncate(int size) {
+		_size = size;
+	}
+
+	/** Removes all the vertices. */
+	void clear() {
+		reset();
+	}
+
+	/** Returns a vector with all the vertices, in the same order. */
+	vector<Point> toPoints() const {
+		vector<Point> points;
+		points.reserve(_size);
+		for (int i = 0; i < _size; ++i) points.push_back(Point(_xs[i], _ys[i]));
+		return points;
+	}
+
+private:
+
+	/** Owned coordinates of up to "inlineCapacity" vertices: the X coordinates and then the Y coordinates. */
+	double _inline[2*inlineCapacity];
+
+	/** Block with the coordinates of more vertices ("_capacity" X coordinates and then "_capacity" Y coordinates), "nullptr" while they fit inside
+		or when they are borrowed. It may be shared with other VertexArrays. */
+	double* _block;
+	int _capacity;
+
+	/** Coordinates in use, either owned or borrowed, and number of vertices. */
+	const double* _xs;
+	const double* _ys;
+	int _size;
+
+	/** Keeps the block or the borrowed memory alive ("null" when the coordinates are inside). */
+	shared_ptr<const void> _owner;
+
+	/** Owned arrays of the X and Y coordinates. */
+	double* ownedXs() { return _block != nullptr ? _block : _inline; }
+	double* ownedYs() { return ownedXs() + _capacity; }
+
+	/** Returns "true" if the coordinates can be modified: they are inside, or in a block that no other VertexArray uses. */
+	bool writable() const { return not _owner or (_block != nullptr and _owner.use_count() == 1); }
+
+	/** Points to the owned coordinates. */
+	void sync() {
+		_xs = ownedXs();
+		_ys = ownedYs();
+	}
+
+	/** Uses the block or the borrowed coordinates of "v", kept alive by "owner". */
+	void share(const VertexArray& v, shared_ptr<const void> owner) {
+		_owner = std::move(owner);
+		_block = v._block;
+		_capacity = v._block != nullptr ? v._capacity : inlineCapacity;
+		_xs = v._xs;
+		_ys = v._ys;
+		_size = v._size;
+	}
+
+	/** Removes the vertices, keeping the memory that can be modified (the coordinates are no longer borrowed nor shared). */
+	void reset() {
+		if (not writable()) {
+			_owner.reset();
+			_block = nullptr;
+			_capacity = inlineCapacity;
+		}
+		_size = 0;
+		sync();
+	}
+
+	/** Removes the vertices and frees the owned memory. */
+	void makeEmpty() {
+		_owner.reset();
+		_block = nullptr;
+		_capacity = inlineCapacity;
+		_size = 0;
+		sync();
+	}
+
+	/** Moves the coordinates to a new block for "capacity" vertices. The old block, if any, is freed when no other VertexArray uses it. */
+	void grow(int capacity) {
+		shared_ptr<double> block(new double[2*size_t(capacity)], default_delete<double[]>());
+		copy(_xs, _xs + _size, block.get());
+		copy(_ys, _ys + _size, block.get() + capacity);
+		_block = block.get();
+		_owner = std::move(block);
+		_capacity = capacity;
+		sync();
+	}
+
+	/** Replaces the vertices by a copy of the "size" coordinates in "xs" and "ys", inside the VertexArray if they fit, or in a new block.
+		The previous block or borrowed memory, if any, is kept alive until the end, since the coordinates may come from it. */
+	void copyFrom(const double* xs, const double* ys, int size) {
+		shared_ptr<const void> previous = std::move(_owner);
+		_block = nullptr;
+		_capacity = inlineCapacity;
+		_size = 0;
+		sync();
+		if (size > inlineCapacity) grow(size);
+		copy(xs, xs + size, ownedXs());
+		copy(ys, ys + size, ownedYs());
+		_size = size;
+	}
+
+	/** Copies the borrowed or shared coordinates, if any, so that they can be modified. */
+	void own() {
+		if (not writable()) copyFrom(_xs, _ys, _size);
+	}
+};
+
+#endif
@@ -0,0 +1,281 @@
+#include "ConvexPolygon.hh"
+#include "Point.hh"
+#include "Parallel.hh"
+#include "Kernels.hh"
+#include "Raster.hh"
+#include "PolygonStore.hh"
+#include "Journal.hh"
+#include <vector>
+#include <array>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+using namespace std;
+
+/* Benchmark of the main operations of the ConvexPolygon class on synthetic inputs. Every operation is run on several kinds of input
+(random clouds of points in a disk or a square, points on a circle, which are all vertices of the hull, collinear points, and pairs of polygons
+that are nested, overlapping or disjoint) and sizes, and the results are written as JSON: one record per operation, input and size,
+with the number of repetitions and the mean and minimum time per call. All the inputs are generated with fixed seeds, so the runs
+of different versions can be compared.
+Usage: bench.exe [output file] (by default, the results are written to the standard output). */
+
+/* Every measurement repeats the operation until it has taken this time (and at least "minRepetitions" times). */
+static const double minSeconds = 0.2;
+static const int minRepetitions = 3;
+
+/* Result of a measurement. */
+struct Result {
+	string operation;
+	string input;
+	int size;
+	int repetitions;
+	double meanNs;
+	double minNs;
+};
+
+static vector<Result> results;
+
+/* Runs "operation" several times and records its time per call. "setup" is called before every repetition, out of the measured time. */
+template <typename Setup, typename Operation>
+static void measure(const string& operation, const string& input, int size, Setup setup, Operation run) {
+	int repetitions = 0;
+	double total = 0;
+	double best = 1e300;
+	while (repetitions < minRepetitions or total < minSeconds*1e9) {
+		setup();
+		auto start = chrono::steady_clock::now();
+		run();
+		auto end = chrono::steady_clock::now();
+		double ns = chrono::duration<double, nano>(end - start).count();
+		total += ns;
+		best = min(best, ns);
+		++repetitions;
+	}
+	results.push_back({operation, input, size, repetitions, total/repetitions, best});
+	cerr << operation << " " << input << " " << size << ": " << total/repetitions/1e6 << " ms" << endl;
+}
+
+template <typename Operation>
+static void measure(const string& operation, const string& input, int size, Operation run) {
+	measure(operation, input, size, [] {}, run);
+}
+
+/* Generators of sets of points. */
+
+static vector<Point> diskCloud(int size, mt19937& random) {
+	uniform_real_distribution<double> unit(0, 1);
+	vector<Point> points;
+	for (int i = 0; i < size; ++i) {
+		double radius = 100*sqrt(unit(random));
+		double angle = 2*M_PI*unit(random);
+		points.push_back(Point(radius*cos(angle), radius*sin(angle)));
+	}
+	return points;
+}
+
+static vector<Point> squareCloud(int size, mt19937& random) {
+	uniform_real_distribution<double> coordinate(-100, 100);
+	vector<Point> points;
+	for (int i = 0; i < size; ++i) points.push_back(Point(coordinate(random), coordinate(random)));
+	return points;
+}
+
+/* Points on a circle of the given center and radius, in random order: all of them are vertices of the hull. */
+static vector<Point> circlePoints(int size, mt19937& random, double cx = 0, double cy = 0, double radius = 100) {
+	vector<Point> points;
+	for (int i = 0; i < size; ++i) {
+		double angle = 2*M_PI*i/size;
+		points.push_back(Point(cx + radius*cos(angle), cy + radius*sin(angle)));
+	}
+	shuffle(points.begin(), points.end(), random);
+	return points;
+}
+
+/* Points on a line, with repetitions: the hull is a segment. */
+static vector<Point> collinearPoints(int size, mt19937& random) {
+	uniform_int_distribution<int> step(0, size/2);
+	vector<Point> points;
+	for (int i = 0; i < size; ++i) {
+		int t = step(random);
+		points.push_back(Point(-100 + 0.5*t, -50 + 0.25*t));
+	}
+	return points;
+}
+
+/* Writes the results as a JSON object. */
+static void writeJson(ostream& out) {
+	out << "{" << endl;
+	out << "  \"threads\": " << hardwareThreads() << "," << endl;
+	const char* kernels[] = {"scalar", "sse2", "avx2"};
+	out << "  \"kernel\": \"" << kernels[kernelLevel()] << "\"," << endl;
+	out << "  \"results\": [" << endl;
+	out.setf(ios::fixed);
+	out.precision(1);
+	for (size_t i = 0; i < results.size(); ++i) {
+		const Result& r = results[i];
+		out << "    {\"operation\": \"" << r.operation << "\", \"input\": \"" << r.input << "\", \"size\": " << r.size
+		    << ", \"repetitions\": " << r.repetitions << ", \"mean_ns\": " << r.meanNs << ", \"min_ns\": " << r.minNs << "}";
+		out << (i + 1 < results.size() ? "," : "") << endl;
+	}
+	out << "  ]" << endl;
+	out << "}" << endl;
+}
+
+int main(int argc, char* argv[]) {
+	mt19937 random(2018);
+	const int sizes[] = {1000, 10000, 100000, 1000000};
+
+	/* Convex hull of every kind of set of points, with and without the prefilter. The hull reorders its input, so every repetition works on a fresh copy. */
+	for (int size : sizes) {
+		vector<pair<string, vector<Point>>> inputs = {
+			{"disk", diskCloud(size, random)},
+			{"square", squareCloud(size, random)},
+			{"circle", circlePoints(size, random)},
+			{"collinear", collinearPoints(size, random)},
+		};
+		for (auto& input : inputs) {
+			vector<Point> points;
+			ConvexPolygon polygon;
+			measure("convexHull", input.first, size, [&] { points = input.second; }, [&] { polygon.convexHull(points); });
+			setHullPrefilter(false);
+			measure("convexHullNoPrefilter", input.first, size, [&] { points = input.second; }, [&] { polygon.convexHull(points); });
+			setHullPrefilter(true);
+		}
+	}
+
+	/* Operations on pairs of polygons with all their points on circles: nested (the second one inside the first one),
+	overlapping (the same radius, with the centers at half a radius) and disjoint. */
+	for (int size : sizes) {
+		vector<pair<string, pair<ConvexPolygon, ConvexPolygon>>> pairs = {
+			{"nested", {ConvexPolygon(circlePoints(size, random)), ConvexPolygon(circlePoints(size, random, 10, 10, 50))}},
+			{"overlapping", {ConvexPolygon(circlePoints(size, random)), ConvexPolygon(circlePoints(size, random, 50, 0, 100))}},
+			{"disjoint", {ConvexPolygon(circlePoints(size, random)), ConvexPolygon(circlePoints(size, random, 300, 0, 100))}},
+		};
+		for (auto& pair : pairs) {
+			ConvexPolygon& first = pair.second.first;
+			ConvexPolygon& second = pair.second.second;
+			ConvexPolygon result;
+			bool answer = false;
+			measure("getIntersection", pair.first, size, [&] { result = result.getIntersection(first, second); });
+			measure("getUnion", pair.first, size, [&] { result = result.getUnion(first, second); });
+			measure("inside", pair.first, size, [&] { answer = second.inside(first); });
+			if (answer != (pair.first == "nested")) cerr << "warning: wrong answer of inside for " << pair.first << " polygons" << endl;
+		}
+	}
+
+	/* Location of 100000 random points in a polygon (the time is per point). */
+	for (int size : sizes) {
+		ConvexPolygon polygon(circlePoints(size, random));
+		vector<Point> queries = squareCloud(100000, random);
+		long found = 0;
+		measure("PointInsidePolygon", "circle", size, [&] {
+			for (const Point& q : queries) found += polygon.PointInsidePolygon(q);
+		});
+		results.back().meanNs /= queries.size();
+		results.back().minNs /= queries.size();
+		if (found == 0) cerr << "warning: no point found inside" << endl;
+	}
+
+	/* Copy of a polygon, which shares its vertices, and copy followed by a change of the copy, which copies them first. */
+	for (int size : sizes) {
+		ConvexPolygon polygon(circlePoints(size, random));
+		ConvexPolygon copy;
+		measure("copy", "circle", size, [&] { copy = polygon; });
+		measure("copyAndAddPoint", "circle", size, [&] {
+			copy = polygon;
+			copy.addPoint(Point(0, 1000));
+		});
+		if (polygon.getVertices() != size) cerr << "warning: the copy changed the original polygon" << endl;
+	}
+
+	/* Growth of a polygon stored with "size" points on a circle by 100 points of a bigger circle (which are always new vertices), sent one per call
+	as a stream of "extend" commands does (the time is per point), and all in a single call. */
+	for (int size : sizes) {
+		ConvexPolygon polygon(circlePoints(size, random));
+		vector<Point> added = circlePoints(100, random, 0, 0, 200);
+		PolygonStore store;
+		Handle h = store.intern("grown");
+		auto reset = [&] { store.setPolygon(h, polygon); };
+		measure("extendOnePerCall", "circle", size, reset, [&] {
+			for (const Point& p : added) {
+				ConvexPolygon grown = store.polygon(h);
+				if (grown.addPoint(p)) store.setPolygon(h, std::move(grown));
+			}
+		});
+		results.back().meanNs /= added.size();
+		results.back().minNs /= added.size();
+		measure("extendAllAtOnce", "circle", size, reset, [&] {
+			ConvexPolygon grown = store.polygon(h);
+			if (grown.addPoints(added)) store.setPolygon(h, std::move(grown));
+		});
+		if (store.polygon(h).getVertices() < int(added.size())) cerr << "warning: the points have not been added" << endl;
+	}
+
+	/* Store of "size" polygons of 16 vertices, without and with a journal (whose records are written and synchronized at the end of every repetition),
+	and replay of a journal with all of them, as done when the calculator starts. */
+	const char* journalFile = "bench.journal";
+	for (int size : {1000, 10000, 100000}) {
+		vector<ConvexPolygon> polygons;
+		vector<string> names;
+		for (int i = 0; i < size; ++i) {
+			polygons.push_back(ConvexPolygon(circlePoints(16, random, i, 0, 10)));
+			names.push_back("p" + to_string(i));
+		}
+		PolygonStore store;
+		for (const string& name : names) store.intern(name);
+		measure("setPolygon", "noJournal", size, [&] {
+			for (int i = 0; i < size; ++i) store.setPolygon(i, polygons[i]);
+			store.compactIfNeeded();
+		});
+		for (bool repeated : {true, false}) {
+			remove(journalFile);
+			PolygonStore journaled;
+			Journal journal;
+			if (not journal.open(journalFile, journaled)) cerr << "warning: the journal cannot be opened" << endl;
+			journaled.setJournal(&journal);
+			for (const string& name : names) journaled.intern(name);
+			auto run = [&] {
+				for (int i = 0; i < size; ++i) journaled.setPolygon(i, polygons[i]);
+				journaled.compactIfNeeded();
+				journal.snapshotIfNeeded(journaled);
+				journal.flush();
+			};
+			if (repeated) measure("setPolygon", "journal", size, run);
+			else run();
+		}
+		measure("journalReplay", "polygons", size, [&] {
+			PolygonStore restored;
+			Journal replayed;
+			replayed.open(journalFile, restored);
+			if (restored.size() != size) cerr << "warning: the journal has not been replayed" << endl;
+		});
+	}
+	remove(journalFile);
+
+	/* Bounding box and drawing of a set of polygons, with "size" vertices in total. */
+	for (int size : sizes) {
+		int count = 10;
+		vector<ConvexPolygon> polygons(count);
+		vector<const ConvexPolygon*> drawn(count);
+		vector<array<unsigned char, 4>> colors(count);
+		for (int i = 0; i < count; ++i) {
+			polygons[i] = ConvexPolygon(circlePoints(size/count, random, 30*i, 10*i, 20 + i));
+			drawn[i] = &polygons[i];
+			vector<double> color = {0.1*i, 0.5, 1 - 0.1*i};
+			colorToRgba(&color, colors[i].data());
+		}
+		ConvexPolygon box;
+		measure("boundingBox", "circles", size, [&] { box = box.boundingBox(drawn); });
+		if (size <= 100000) measure("drawPolygon", "circles", size, [&] { box.drawPolygon(drawn, colors, box, "bench.png"); });
+	}
+	remove("bench.png");
+
+	if (argc > 1) {
+		ofstream out(argv[1]);
+		writeJson(out);
+	} else writeJson(cout);
+}
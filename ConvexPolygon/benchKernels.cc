@@ -0,0 +1,89 @@
+#include "Kernels.hh"
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <algorithm>
+using namespace std;
+
+/* Microbenchmark of the reductions used to compute the area, perimeter, centroid and bounds of a ConvexPolygon, and of the search of the extreme
+points done by the prefilter of the convex hull. For polygons from 1k to 1M vertices (points on a circle, all of them vertices), it prints 
+the time per call of every kernel level supported by the processor and its speedup with respect to the scalar one. */
+
+/* Returns the average time in nanoseconds of "kernel" on a polygon with the given number of vertices. */
+template <typename Kernel>
+static double timeKernel(int size, Kernel kernel) {
+	int repetitions = max(1, 20000000/size);
+	auto start = chrono::steady_clock::now();
+	for (int r = 0; r < repetitions; ++r) kernel();
+	auto end = chrono::steady_clock::now();
+	return chrono::duration<double, nano>(end - start).count()/repetitions;
+}
+
+/* Prints the header of a table. */
+static void printHeader(const string& kernel, KernelLevel best) {
+	const char* names[] = {"scalar", "sse2", "avx2"};
+	cout << kernel << endl << "vertices";
+	for (int level = ScalarKernel; level <= best; ++level) cout << "\t" << names[level] << " (us)";
+	for (int level = ScalarKernel + 1; level <= best; ++level) cout << "\t" << names[level] << " speedup";
+	cout << endl;
+}
+
+/* Prints a row of a table. */
+static void printRow(int size, const vector<double>& times) {
+	cout << size;
+	for (double time : times) cout << "\t" << time/1000;
+	for (size_t i = 1; i < times.size(); ++i) cout << "\t" << times[0]/times[i] << "x";
+	cout << endl;
+}
+
+int main() {
+	const char* names[] = {"scalar", "sse2", "avx2"};
+	KernelLevel best = bestKernelLevel();
+	cout.setf(ios::fixed);
+	cout.precision(1);
+	printHeader("polygonSums", best);
+
+	for (int size = 1000; size <= 1000000; size *= 10) {
+		vector<double> x(size), y(size);
+		for (int i = 0; i < size; ++i) {
+			double angle = -2*M_PI*i/size;    // Clockwise, as the vertices of a ConvexPolygon.
+			x[i] = 100*cos(angle);
+			y[i] = 100*sin(angle);
+		}
+		vector<double> times;
+		double area = 0;
+		for (int level = ScalarKernel; level <= best; ++level) {
+			setKernelLevel(KernelLevel(level));
+			PolygonSums sums;
+			times.push_back(timeKernel(size, [&] { polygonSums(x.data(), y.data(), size, sums); }));
+			if (level == ScalarKernel) area = sums.area;
+			else if (abs(sums.area - area) > 1e-9*abs(area)) cerr << "warning: " << names[level] << " area differs from the scalar one" << endl;
+		}
+		printRow(size, times);
+	}
+
+	printHeader("extremePoints", best);
+	for (int size = 1000; size <= 1000000; size *= 10) {
+		vector<double> xy(2*size);
+		for (int i = 0; i < size; ++i) {
+			double angle = 2*M_PI*i/size;
+			xy[2*i] = 100*cos(angle);
+			xy[2*i + 1] = 100*sin(angle);
+		}
+		vector<double> times;
+		ExtremePoints first;
+		for (int level = ScalarKernel; level <= best; ++level) {
+			setKernelLevel(KernelLevel(level));
+			ExtremePoints extremes;
+			times.push_back(timeKernel(size, [&] { extremePoints(xy.data(), size, extremes); }));
+			if (level == ScalarKernel) first = extremes;
+			else if (not equal(first.position, first.position + 8, extremes.position)) {
+				cerr << "warning: " << names[level] << " extreme points differ from the scalar ones" << endl;
+			}
+		}
+		printRow(size, times);
+	}
+	setKernelLevel(best);
+}
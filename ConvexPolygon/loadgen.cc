@@ -0,0 +1,163 @@
+#include "Server.hh"
+#include "CommandLine.hh"
+#include "Output.hh"
+#include "Stats.hh"
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+using namespace std;
+
+/* Load generator for the server mode of the calculator. It creates a set of polygons through one session, and then opens several sessions
+that send commands at the same time, each one waiting for the answer of a command before sending the next one (as an interactive client would).
+Most commands read a polygon (area, perimeter, centroid, print and inside, in the same proportion), and the rest change one (a new polygon
+or a new color). It writes the throughput and the median, 99th and 99.9th percentiles and maximum of the latency of the commands, as seen by
+the clients, for all of them and for the reads and the writes apart. The commands are generated with fixed seeds, so the runs against
+different versions of the server can be compared.
+Usage: loadgen.exe socket [sessions] [commands per session] [percentage of writes] [polygons] [vertices per polygon]. */
+
+/* Parameters of the load, with their default values. */
+static int sessions = 8;
+static long commandsPerSession = 20000;
+static int writePercentage = 10;
+static int polygons = 1000;
+static int vertices = 32;
+
+/* Latency of the commands in nanoseconds, and number of answers that are errors. */
+static Histogram allLatency, readLatency, writeLatency;
+static atomic<long> errors(0);
+
+/* Writes the command "polygon" for the polygon "k", with "vertices" random points in a disk of radius 10 around a random center. */
+static void writePolygon(Output& out, int k, mt19937& random) {
+	uniform_real_distribution<double> center(-100, 100), unit(-1, 1);
+	double cx = center(random), cy = center(random);
+	out << "polygon load" << k;
+	for (int i = 0; i < vertices; ++i) {
+		double x, y;
+		do {
+			x = unit(random);
+			y = unit(random);
+		} while (x*x + y*y > 1);
+		out << " " << cx + 10*x << " " << cy + 10*y;
+	}
+	out << endLine;
+}
+
+/* Writes a random command and returns "true" if it changes a polygon. */
+static bool writeCommand(Output& out, mt19937& random) {
+	uniform_int_distribution<int> polygon(0, polygons - 1), percentage(0, 99), kind(0, 4), channel(0, 255);
+	int k = polygon(random);
+	if (percentage(random) < writePercentage) {
+		if (kind(random) % 2 == 0) writePolygon(out, k, random);
+		else out << "setcol load" << k << " " << channel(random)/255.0 << " " << channel(random)/255.0 << " " << channel(random)/255.0 << endLine;
+		return true;
+	}
+	const char* reads[] = {"area", "perimeter", "centroid", "print"};
+	int read = kind(random);
+	if (read < 4) out << reads[read] << " load" << k << endLine;
+	else out << "inside load" << k << " load" << polygon(random) << endLine;
+	return false;
+}
+
+/* Reads an answer line, counting it if it is an error. Returns "false" if the server has closed the connection. */
+static bool readAnswer(LineReader& in) {
+	const char* begin;
+	const char* end;
+	if (not in.next(begin, end)) return false;
+	if (end - begin >= 6 and string(begin, 6) == "error:") ++errors;
+	return true;
+}
+
+/* Creates the polygons, sending them in groups and then reading their answers, so that neither side fills the buffers of the socket. */
+static bool createPolygons(const string& nameSocket) {
+	int fd = connectSocket(nameSocket);
+	if (fd < 0) return false;
+	bool ok = true;
+	{
+		Output out(fd);
+		LineReader in(fd);
+		mt19937 random(1);
+		const int group = 256;
+		for (int first = 0; first < polygons and ok; first += group) {
+			int last = min(polygons, first + group);
+			for (int k = first; k < last; ++k) writePolygon(out, k, random);
+			out.flush();
+			for (int k = first; k < last and ok; ++k) ok = readAnswer(in);
+		}
+	}
+	close(fd);
+	return ok;
+}
+
+/* Writes the percentiles of a histogram of latencies in microseconds. */
+static void printLatency(const char* name, const Histogram& latency) {
+	if (latency.count() == 0) return;
+	cout << name << ": " << latency.count() << " commands, p50 " << latency.percentile(0.5)/1000.0 << " us, p99 " << latency.percentile(0.99)/1000.0
+	     << " us, p99.9 " << latency.percentile(0.999)/1000.0 << " us, max " << latency.max()/1000.0 << " us" << endl;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2 or argc > 7) {
+		cerr << "usage: " << argv[0] << " socket [sessions] [commands per session] [percentage of writes] [polygons] [vertices per polygon]" << endl;
+		return 1;
+	}
+	string nameSocket = argv[1];
+	if (argc > 2) sessions = max(1, atoi(argv[2]));
+	if (argc > 3) commandsPerSession = max(1L, atol(argv[3]));
+	if (argc > 4) writePercentage = min(100, max(0, atoi(argv[4])));
+	if (argc > 5) polygons = max(1, atoi(argv[5]));
+	if (argc > 6) vertices = max(1, atoi(argv[6]));
+
+	if (not createPolygons(nameSocket)) {
+		cerr << "error: unable to open socket " << nameSocket << endl;
+		return 1;
+	}
+	vector<int> connections;
+	for (int s = 0; s < sessions; ++s) {
+		int fd = connectSocket(nameSocket);
+		if (fd < 0) {
+			cerr << "error: unable to open socket " << nameSocket << endl;
+			return 1;
+		}
+		connections.push_back(fd);
+	}
+	cerr << sessions << " sessions, " << commandsPerSession << " commands each, " << writePercentage << "% writes, "
+	     << polygons << " polygons of " << vertices << " points" << endl;
+
+	atomic<long> completed(0);
+	auto start = chrono::steady_clock::now();
+	vector<thread> clients;
+	for (int s = 0; s < sessions; ++s) {
+		clients.push_back(thread([&, s] {
+			{
+				Output out(connections[s]);
+				LineReader in(connections[s]);
+				mt19937 random(1000 + s);
+				for (long i = 0; i < commandsPerSession; ++i) {
+					auto sent = chrono::steady_clock::now();
+					bool write = writeCommand(out, random);
+					out.flush();
+					if (not readAnswer(in)) break;
+					uint64_t ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - sent).count();
+					allLatency.record(ns);
+					(write ? writeLatency : readLatency).record(ns);
+					++completed;
+				}
+			}
+			close(connections[s]);
+		}));
+	}
+	for (thread& client : clients) client.join();
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	cout << completed << " commands in " << seconds << " s: " << long(completed/seconds) << " commands/s, " << errors << " errors" << endl;
+	printLatency("all", allLatency);
+	printLatency("reads", readLatency);
+	printLatency("writes", writeLatency);
+	return completed == sessions*commandsPerSession ? 0 : 1;
+}
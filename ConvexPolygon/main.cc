@@ -1,32 +1,91 @@
 #include "ConvexPolygon.hh"
 #include "Point.hh"
-#include <map>
+#include "BinaryStore.hh"
+#include "TextLoader.hh"
+#include "CommandLine.hh"
+#include "Output.hh"
+#include "Batch.hh"
+#include "Parallel.hh"
+#include "SpatialIndex.hh"
+#include "Stats.hh"
+#include "TilePyramid.hh"
+#include "PolygonStore.hh"
+#include "StreamHull.hh"
+#include "Raster.hh"
+#include "ImageQueue.hh"
+#include "Journal.hh"
+#include "Server.hh"
 #include <iostream>
 #include <pngwriter.h>
-#include <sstream>
 #include <vector>
 #include <string>
 #include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <unistd.h>
 using namespace std;
 
+/** Spatial index of the polygons, used by the containing, overlapping and nearest commands. 
+	The polygons changed by every command are reported to it by "reportChanges". */
+SpatialIndex spatialIndex;
+
+/** Images being drawn in the background by the draw and fill commands. */
+ImageQueue imageQueue;
+
+/** Position of the command run by the current thread in the script, used to report the images that cannot be written in the order of their commands.
+	In the server mode, it goes after the positions of the previous sessions ("sessionCommands" for each one). */
+static thread_local long currentCommand = 0;
+
+/** Session of the server run by the current thread ("-1" outside the server mode), and room for the positions of the commands of every session. */
+static thread_local long currentSession = -1;
+const long sessionCommands = 1L << 32;
+
+/** Locks of the server mode: the commands that may use any polygon hold "storeLock" as the writer, and the other ones hold it as readers
+	and hold the identifiers and files that they use in "resourceLocks". They report their changes to the spatial index holding "indexLock". */
+ReadWriteLock storeLock;
+ResourceLocks resourceLocks;
+mutex indexLock;
+
+/** Journal where the changes of the polygons are recorded, when the calculator is started with the "--journal" option. */
+Journal journal;
+
+/** Color of the new polygons: black and opaque. */
+const unsigned char black[4] = {0, 0, 0, 255};
 
 /** If the given name does not match any of the ConvexPolygon's name in all the set of polygons, writes an error line and returns "true" 
 	since there's been an error.
-	Otherwise, returns "false". */
-bool undefinedIdentifier(map<string, ConvexPolygon>& polygons, string name) {
-	auto it = polygons.find(name);
-	if (it == polygons.end()) {
-		cout << "error: undefined identifier" << endl;
+	Otherwise, stores the handle of the polygon in "h" and returns "false". */
+bool undefinedIdentifier(const PolygonStore& store, const string& name, Handle& h, Output& output) {
+	h = store.findDefined(name);
+	if (h == noHandle) {
+		output << "error: undefined identifier" << endLine;
 		return true;
 	}
 	return false;
 }
 
+/** Returns an empty vector of points that is reused by the commands run by the same thread, so that the commands on small polygons
+	do not allocate memory. */
+vector<Point>& pointBuffer() {
+	static thread_local vector<Point> buffer;
+	buffer.clear();
+	return buffer;
+}
+
+/** Returns an empty vector of polygons that is reused by the commands run by the same thread, like "pointBuffer". */
+vector<const ConvexPolygon*>& polygonBuffer() {
+	static thread_local vector<const ConvexPolygon*> buffer;
+	buffer.clear();
+	return buffer;
+}
+
 /** If the first letter of the given name is a digit, writes an error line and returns "false", there's an error on the type of the argument. 
 	Otherwise, returns "true". */
-bool isString(string name) {
+bool isString(const string& name, Output& output) {
 	if (isdigit(name[0])) {
-		cout << "error: wrong type argument" << endl;
+		output << "error: wrong type argument" << endLine;
 		return false;
 	}
 	return true;
@@ -36,234 +95,1055 @@ bool isString(string name) {
 	If the polygon identifier is new, it will create it. 
 	If it already existed, it will overwrite the previous polygon. 
 	New polygons are black. */
-void createNewPolygon(map<string, ConvexPolygon>& polygons, map<string, vector<double>>& colors, istringstream& iss) {
+void createNewPolygon(PolygonStore& store, CommandLine& args, Output& output) {
 	string name;
-	iss >> name;
-	if (not isString(name)) return;
+	args >> name;
+	if (not isString(name, output)) return;
 	
-	vector<Point> points;
+	vector<Point>& points = pointBuffer();
 	double x, y;
-	while (iss >> x >> y) {
+	while (args >> x >> y) {
 		Point p = {x, y};
 		points.push_back(p);
 	} 
 	
-	ConvexPolygon newPolygon(points);
-    polygons[name] = newPolygon;
-    colors[name] = {0, 0, 0};
+	Handle h = store.intern(name);
+	store.setPolygon(h, ConvexPolygon::fromPoints(points));
+	store.setColor(h, black);
+}
+
+/** Adds a set of zero or more points to an existing polygon, which becomes the convex hull of its vertices and the new points.
+	Its color does not change. */
+void extendPolygon(PolygonStore& store, CommandLine& args, Output& output) {
+	string name;
+	args >> name;
+	Handle h;
+	if (undefinedIdentifier(store, name, h, output)) return;
+
+	vector<Point>& points = pointBuffer();
+	double x, y;
+	while (args >> x >> y) {
+		Point p = {x, y};
+		points.push_back(p);
+	}
+
+	ConvexPolygon polygon = store.polygon(h);
+	if (polygon.addPoints(points)) store.setPolygon(h, std::move(polygon));
+	output << "ok" << endLine;
 }
 
 /** Prints the name and the vertices of a given ConvexPolygon. */
-void printVertices(map<string, ConvexPolygon>& polygons, istringstream& iss) {
+void printVertices(PolygonStore& store, CommandLine& args, Output& output) {
 	string name;
-	iss >> name;
-	if (undefinedIdentifier(polygons, name)) return;
-	cout << name;
-	polygons[name].printVertices();
+	args >> name;
+	Handle h;
+	if (undefinedIdentifier(store, name, h, output)) return;
+	output << name;
+	const VertexArray& points = store.polygon(h).getPoints();
+	for (int i = 0; i < points.size(); ++i) output << " " << points.x(i) << " " << points.y(i);
+	output << endLine;
 }
 
 /** Prints the area of the given ConvexPolygon. */
-void getArea(map<string, ConvexPolygon>& polygons, istringstream& iss) {
+void getArea(PolygonStore& store, CommandLine& args, Output& output) {
 	string name;
-	iss >> name;
+	args >> name;
 	
-	if (undefinedIdentifier(polygons, name)) return;
-	cout << polygons[name].getArea() << endl;
+	Handle h;
+	if (undefinedIdentifier(store, name, h, output)) return;
+	output << store.polygon(h).getArea() << endLine;
 }
 
 /** Prints the perimeter of the given ConvexPolygon. */
-void getPerimeter(map<string, ConvexPolygon>& polygons, istringstream& iss) {
+void getPerimeter(PolygonStore& store, CommandLine& args, Output& output) {
 	string name;
-	iss >> name;
-	if (undefinedIdentifier(polygons, name)) return;
-	cout << polygons[name].getPerimeter() << endl;
+	args >> name;
+	Handle h;
+	if (undefinedIdentifier(store, name, h, output)) return;
+	output << store.polygon(h).getPerimeter() << endLine;
 }
 
 /** Prints the number of vertices of the convex hull of the given polygon. */
-void getVertices(map<string, ConvexPolygon>& polygons, istringstream& iss) {
+void getVertices(PolygonStore& store, CommandLine& args, Output& output) {
 	string name;
-	iss >> name;
-	if (undefinedIdentifier(polygons, name)) return;
-	cout << polygons[name].getVertices() << endl;
+	args >> name;
+	Handle h;
+	if (undefinedIdentifier(store, name, h, output)) return;
+	output << store.polygon(h).getVertices() << endLine;
 }
 
 /** Prints the centroid of the given ConvexPolygon. */
-void getCentroid(map<string, ConvexPolygon>& polygons, istringstream& iss) {
+void getCentroid(PolygonStore& store, CommandLine& args, Output& output) {
 	string name;
-	iss >> name;
+	args >> name;
 	
-	if (undefinedIdentifier(polygons, name)) return;
-	cout << polygons[name].getCentroid().get_x() << " " << polygons[name].getCentroid().get_y() << endl;
+	Handle h;
+	if (undefinedIdentifier(store, name, h, output)) return;
+	Point centroid = store.polygon(h).getCentroid();
+	output << centroid.get_x() << " " << centroid.get_y() << endLine;
 }
 
 /** lists all polygon identifiers, lexycographically sorted. */
-void getList(map<string, ConvexPolygon>& polygons) {
+void getList(PolygonStore& store, CommandLine& args, Output& output) {
 	bool first = true;
-	for (auto e : polygons) {
+	for (Handle h : store.sortedHandles()) {
 		if (first) {
-			cout << e.first;
+			output << store.name(h);
 			first = false;
-		} else cout << " " << e.first;
-	} cout << endl;
-	if (first) cout << "error: void list" << endl;
+		} else output << " " << store.name(h);
+	} output << endLine;
+	if (first) output << "error: void list" << endLine;
 }
 
 /** Saves the given polygons in a file, overwriting it if it already existed. 
-	The contents of the file are the same as in the print command, with a polygon per line. */
-void saveFile(map<string, ConvexPolygon>& polygons, istringstream& iss) {
+	The contents of the file are the same as in the print command, with a polygon per line. 
+	If the name of the file ends with ".cpb", the polygons are saved in the binary format instead. */
+void saveFile(PolygonStore& store, CommandLine& args, Output& output) {
 	string outFile;
-	iss >> outFile;
+	args >> outFile;
+	if (hasBinaryExtension(outFile)) {
+		vector<string> names;
+		vector<const ConvexPolygon*> saved;
+		string name;
+		Handle h;
+		while (args >> name) {
+			if (undefinedIdentifier(store, name, h, output)) return;
+			names.push_back(name);
+			saved.push_back(&store.polygon(h));
+		}
+		if (not saveBinary(outFile, names, saved)) output << "error: unable to write file" << endLine;
+		else output << "ok" << endLine;
+		return;
+	}
 	ofstream out(outFile);
 	string name;
+	Handle h;
 	
-	while (iss >> name) {
-		if (undefinedIdentifier(polygons, name)) return;
+	while (args >> name) {
+		if (undefinedIdentifier(store, name, h, output)) return;
 		out << name;
-		for (int i = 0; i < polygons[name]._points.size(); ++i) out << " " << polygons[name]._points[i].get_x() << " " << polygons[name]._points[i].get_y();
+		const VertexArray& points = store.polygon(h).getPoints();
+		for (int i = 0; i < points.size(); ++i) out << " " << points[i].get_x() << " " << points[i].get_y();
 		out << endl;
 	} 
 	
 	out.close();
-	cout << "ok" << endl;
+	output << "ok" << endLine;
 }
 
-/** Loads the polygons stored in a file, in the same way as polygon, but retrieving the vertices and identifiers from the file. */
-void loadFile(map<string, ConvexPolygon>& polygons, map<string, vector<double>>& colors, istringstream& iss) {
+/** Loads the polygons stored in a file, in the same way as polygon, but retrieving the vertices and identifiers from the file. 
+	Text files are read in parallel, but the polygons are stored in the same order as their lines, so the last line wins when a name is repeated.
+	Files in the binary format are memory-mapped, and their polygons are used as they are stored, without building their convex hulls again. */
+void loadFile(PolygonStore& store, CommandLine& args, Output& output) {
 	string nameFile;
-	iss >> nameFile; 
-	if (not isString(nameFile)) return;
-	ifstream inFile(nameFile);
-	string line;
-	while (getline(inFile, line)) {
-		istringstream iss(line);
-		createNewPolygon(polygons, colors, iss);
+	args >> nameFile; 
+	if (not isString(nameFile, output)) return;
+	if (isBinaryStore(nameFile)) {
+		vector<pair<string, ConvexPolygon>> loaded;
+		if (not loadBinary(nameFile, loaded)) {
+			output << "error: wrong format" << endLine;
+			return;
+		}
+		for (size_t i = 0; i < loaded.size(); ++i) {
+			Handle h = store.intern(loaded[i].first);
+			store.setMappedPolygon(h, std::move(loaded[i].second));
+			store.setColor(h, black);
+		}
+		output << "ok" << endLine;
+		return;
 	}
-	inFile.close();
-	cout << "ok" << endl;
+	loadText(nameFile, [&](TextPolygon& loaded) {
+		if (not loaded.validName) {
+			output << "error: wrong type argument" << endLine;
+			return;
+		}
+		Handle h = store.intern(loaded.name);
+		store.setPolygon(h, std::move(loaded.polygon));
+		store.setColor(h, black);
+	});
+	output << "ok" << endLine;
 }
 
-/** Associates a color to the given polygon. */
-void setCol(map<string, ConvexPolygon>& polygons, map<string, vector<double>>& colors, istringstream& iss) {
+/** Associates an identifier with the convex hull of the points stored in a raw binary file (pairs of little-endian doubles), which is read
+	in chunks of the given number of points (by default, "defaultChunkPoints"), so it can be bigger than the memory. Like the polygon command, it overwrites the polygon if it already existed, and it becomes black. */
+void streamHullFile(PolygonStore& store, CommandLine& args, Output& output) {
+	string name, nameFile;
+	args >> name >> nameFile;
+	if (not isString(name, output)) return;
+	long chunkPoints = defaultChunkPoints;
+	double chunk;
+	if (args >> chunk) {
+		if (not (chunk >= 1 and chunk <= (1L << 40))) {
+			output << "error: wrong type argument" << endLine;
+			return;
+		}
+		chunkPoints = long(chunk);
+	}
+	ConvexPolygon hull;
+	StreamResult result = streamHull(nameFile, chunkPoints, hardwareThreads(), hull);
+	if (result == StreamUnreadable) {
+		output << "error: unable to open file" << endLine;
+		return;
+	}
+	if (result == StreamWrongFormat) {
+		output << "error: wrong format" << endLine;
+		return;
+	}
+	Handle h = store.intern(name);
+	store.setPolygon(h, std::move(hull));
+	store.setColor(h, black);
+	output << "ok" << endLine;
+}
+
+/** Associates a color to the given polygon. It is stored as red, green, blue and alpha values from 0 to 255. */
+void setCol(PolygonStore& store, CommandLine& args, Output& output) {
 	string name;
-	iss >> name;
-	if (undefinedIdentifier(polygons, name)) return;
+	args >> name;
+	Handle h;
+	if (undefinedIdentifier(store, name, h, output)) return;
 	vector<double> setColor;
 	double color;
-	while (iss >> color) {
-		setColor.push_back(color);
-		colors[name] = setColor;
-	}	
-	cout << "ok" << endl;
+	while (args >> color) setColor.push_back(color);
+	if (not setColor.empty()) {
+		unsigned char rgba[4];
+		colorToRgba(&setColor, rgba);
+		store.setColor(h, rgba);
+	}
+	output << "ok" << endLine;
 }
 
-/** Draws a list of polygons in a PNG file, each one with its associated color. 
-	The image is of 500x500 pixels, with white background and the coordinates of the vertices are scaled
-	to fit in the 498x498 central part of the image, while preserving the original aspect ratio. */
-void drawPolygon(map<string, ConvexPolygon>& polygons, map<string, vector<double>>& colors, istringstream& iss) {
+/** Largest width and height of an image. */
+const int maxImageSize = 16384;
+
+/** Draws a list of polygons in a PNG file, each one with its associated color, as outlines or filled. 
+	The image is of 500x500 pixels unless the name of the file is followed by its width and height (or by a single size, for a square image).
+	It has white background and the coordinates of the vertices are scaled to fit in the image without its outer pixels, while preserving the original aspect ratio.
+	The polygons and their colors are copied, and the image is drawn and written in the background, so the "ok" does not mean that the file
+	has been written: the files that cannot be written are reported by the sync command, or when the script ends. */
+void drawPolygons(PolygonStore& store, CommandLine& args, Output& output, DrawMode mode) {
 	string nameFile;  
-	iss >> nameFile;
+	args >> nameFile;
+	int size[2] = {500, 500};
+	int sizes = 0;
+	string word;
+	shared_ptr<vector<ConvexPolygon>> insiders(new vector<ConvexPolygon>());
+	shared_ptr<vector<array<unsigned char, 4>>> rgba(new vector<array<unsigned char, 4>>());
+	Handle h;
+	while (args >> word) {
+		if (isdigit(word[0])) {
+			char* end;
+			long value = strtol(word.c_str(), &end, 10);
+			if (not insiders->empty() or sizes == 2 or *end != '\0' or value < 3 or value > maxImageSize) {
+				output << "error: wrong type argument" << endLine;
+				return;
+			}
+			size[sizes++] = value;
+		} else if (undefinedIdentifier(store, word, h, output)) return;
+		else {
+			insiders->push_back(store.polygon(h));
+			const unsigned char* color = store.color(h);
+			rgba->push_back({{color[0], color[1], color[2], color[3]}});
+		}
+	}
+	if (insiders->empty()) {
+		output << "error: wrong type argument" << endLine;
+		return;
+	}
+	if (sizes == 1) size[1] = size[0];
+	int width = size[0], height = size[1];
+	imageQueue.submit(currentCommand, nameFile, [=] {
+		vector<const ConvexPolygon*> drawn;
+		for (const ConvexPolygon& polygon : *insiders) drawn.push_back(&polygon);
+		ConvexPolygon boundingBox = drawn[0]->boundingBox(drawn);
+		return boundingBox.drawPolygon(drawn, *rgba, boundingBox, nameFile, mode, width, height);
+	});
+	output << "ok" << endLine;
+}
+
+/** Waits until all the images drawn until now have been written, and writes an error line for every image that could not be written
+	(in the order of the commands that drew them). In the server mode, only the images of the current session are reported. Returns "false" if there is any. */
+bool reportImages(Output& output) {
+	vector<string> failed;
+	if (currentSession < 0) imageQueue.collect(failed);
+	else imageQueue.collect(currentSession*sessionCommands, (currentSession + 1)*sessionCommands, failed);
+	for (const string& nameFile : failed) output << "error: unable to write file " << nameFile << endLine;
+	return failed.empty();
+}
+
+/** Waits until the images drawn by the previous commands have been written, and reports the ones that could not be written.
+	Writes an "ok" if all of them have been written. */
+void syncImages(PolygonStore& store, CommandLine& args, Output& output) {
+	if (reportImages(output)) output << "ok" << endLine;
+}
+
+/** Draws the outlines of a list of polygons in a PNG file. */
+void drawPolygon(PolygonStore& store, CommandLine& args, Output& output) {
+	drawPolygons(store, args, output, Outline);
+}
+
+/** Draws a list of filled polygons in a PNG file. */
+void fillPolygon(PolygonStore& store, CommandLine& args, Output& output) {
+	drawPolygons(store, args, output, Fill);
+}
+
+/** Draws a list of filled polygons as a tile pyramid with the given number of levels, in the given directory, and prints how many tiles
+	have been drawn again, how many have not changed since the pyramid was last drawn, and how many have been removed. */
+void drawTiles(PolygonStore& store, CommandLine& args, Output& output) {
+	string directory;
+	double levels;
+	if (not (args >> directory >> levels) or levels != int(levels) or levels < 1 or levels > maxTileLevels) {
+		output << "error: wrong type argument" << endLine;
+		return;
+	}
+	vector<const ConvexPolygon*> insiders;
+	vector<array<unsigned char, 4>> rgba;
 	string namePolygon;
-	vector<string> insiders;
-	while (iss >> namePolygon) {
-		if (undefinedIdentifier(polygons, namePolygon)) return;
-		else insiders.push_back(namePolygon);
+	Handle h;
+	while (args >> namePolygon) {
+		if (undefinedIdentifier(store, namePolygon, h, output)) return;
+		insiders.push_back(&store.polygon(h));
+		const unsigned char* color = store.color(h);
+		rgba.push_back({{color[0], color[1], color[2], color[3]}});
 	}
-	ConvexPolygon boundingBox;
-	boundingBox = polygons[insiders[0]].boundingBox(polygons, insiders);
-	boundingBox.drawPolygon(polygons, colors, insiders, boundingBox, nameFile);
-	cout << "ok" << endl;
+	TileCounts counts;
+	if (not renderTiles(insiders, rgba, directory, int(levels), counts)) {
+		output << "error: unable to write file" << endLine;
+		return;
+	}
+	output << "rendered " << counts.rendered << " unchanged " << counts.unchanged << " removed " << counts.removed << endLine;
 }
 
 /** When receiving two parameters ("p1" and "p2"), "p1" is updated to the intersection of the original "p1" and "p2".
 	When receiving three parameters ("p1", "p2" and "p3"), "p1" is updated to the intersection of p2 and p3. */
-void getIntersection(map<string, ConvexPolygon>& polygons, istringstream& iss) {
+void getIntersection(PolygonStore& store, CommandLine& args, Output& output) {
 	string name;
-	iss >> name; 
+	args >> name; 
 	string p1 = name;
-	iss >> name;
+	args >> name;
 	string p2 = name;
-	if (iss >> name) {
+	Handle h1, h2, h3;
+	if (args >> name) {
 		string p3 = name;
-		if (undefinedIdentifier(polygons, p2) or undefinedIdentifier(polygons, p3)) return;
-		polygons[p1] = polygons[p1].getIntersection(polygons[p2], polygons[p3]);
+		if (undefinedIdentifier(store, p2, h2, output) or undefinedIdentifier(store, p3, h3, output)) return;
+		h1 = store.intern(p1);
+		store.setPolygon(h1, store.polygon(h1).getIntersection(store.polygon(h2), store.polygon(h3)));
 	} else {
-		if (undefinedIdentifier(polygons, p1) or undefinedIdentifier(polygons, p2)) return;
-		polygons[p1] = polygons[p1].getIntersection(polygons[p1], polygons[p2]);
+		if (undefinedIdentifier(store, p1, h1, output) or undefinedIdentifier(store, p2, h2, output)) return;
+		store.setPolygon(h1, store.polygon(h1).getIntersection(store.polygon(h1), store.polygon(h2)));
 	}  
-	cout << "ok" << endl;
+	output << "ok" << endLine;
 } 
 
-/** Just as the intersection command, but with the convex union of polygons. */
-void getUnion(map<string, ConvexPolygon>& polygons, istringstream& iss) {
+/** Just as the intersection command, but with the convex union of polygons. 
+	When receiving more than three parameters, "p1" is updated to the union of all the others. */
+void getUnion(PolygonStore& store, CommandLine& args, Output& output) {
 	string name;
-	iss >> name;
+	args >> name;
 	string p1 = name;
-	iss >> name;
+	args >> name;
 	string p2 = name;
-	if (iss >> name) {
-		string p3 = name;
-		if (undefinedIdentifier(polygons, p2) or undefinedIdentifier(polygons, p3)) return;
-		polygons[p1] = polygons[p1].getUnion(polygons[p2], polygons[p3]);
+	Handle h1, h2;
+	if (args >> name) {
+		vector<const ConvexPolygon*>& united = polygonBuffer();
+		if (undefinedIdentifier(store, p2, h2, output)) return;
+		united.push_back(&store.polygon(h2));
+		do {
+			if (undefinedIdentifier(store, name, h2, output)) return;
+			united.push_back(&store.polygon(h2));
+		} while (args >> name);
+		h1 = store.intern(p1);
+		store.setPolygon(h1, store.polygon(h1).getUnion(united));
 	} else {
-		if (undefinedIdentifier(polygons, p1) or undefinedIdentifier(polygons, p2)) return;
-		polygons[p1] = polygons[p1].getUnion(polygons[p1], polygons[p2]);
+		if (undefinedIdentifier(store, p1, h1, output) or undefinedIdentifier(store, p2, h2, output)) return;
+		store.setPolygon(h1, store.polygon(h1).getUnion(store.polygon(h1), store.polygon(h2)));
 	}  
-	cout << "ok" << endl;
+	output << "ok" << endLine;
 } 
 
 /** Given two polygons, prints "yes" or "not" to tell whether the first is inside the second or not. */
-void inside(map<string, ConvexPolygon>& polygons, istringstream& iss) {
+void inside(PolygonStore& store, CommandLine& args, Output& output) {
 	string firstPolygon, secondPolygon;
-	iss >> firstPolygon >> secondPolygon;
-	if (undefinedIdentifier(polygons, firstPolygon) or undefinedIdentifier(polygons, secondPolygon)) return;
-	cout << (polygons[firstPolygon].inside(polygons[secondPolygon]) ? "yes" : "no") << endl;
+	args >> firstPolygon >> secondPolygon;
+	Handle h1, h2;
+	if (undefinedIdentifier(store, firstPolygon, h1, output) or undefinedIdentifier(store, secondPolygon, h2, output)) return;
+	output << (store.polygon(h1).inside(store.polygon(h2)) ? "yes" : "no") << endLine;
+}
+
+/** Classifies the points stored in a file (X and Y coordinates separated by spaces) with respect to the given polygon, 
+	and prints how many of them are inside it, on its boundary and outside it. 
+	When a second file name is given, the position of every point is also written there, one per line. 
+	Anything in the file that is not a coordinate is a format error. */
+void classifyPoints(PolygonStore& store, CommandLine& args, Output& output) {
+	string name, nameFile, outFile;
+	args >> name >> nameFile;
+	Handle h;
+	if (undefinedIdentifier(store, name, h, output)) return;
+	ifstream inFile(nameFile);
+	if (not inFile) {
+		output << "error: unable to open file" << endLine;
+		return;
+	}
+	bool writeAll = bool(args >> outFile);
+	ofstream out;
+	if (writeAll) {
+		out.open(outFile);
+		if (not out) {
+			output << "error: unable to write file" << endLine;
+			return;
+		}
+	}
+
+	const char* names[] = {"outside", "boundary", "inside"};
+	const int blockSize = 1 << 16;    // The blocks grow up to this size, so small files only take the memory they need.
+	vector<double> xs, ys;
+	vector<PointPosition> positions;
+	long counts[3] = {0, 0, 0};
+	const ConvexPolygon& polygon = store.polygon(h);
+	bool endOfFile = false;
+	while (not endOfFile) {
+		xs.clear();
+		ys.clear();
+		double x, y;
+		while (xs.size() < blockSize and inFile >> x) {
+			if (not (inFile >> y)) {
+				output << "error: wrong format" << endLine;
+				return;
+			}
+			xs.push_back(x);
+			ys.push_back(y);
+		}
+		int size = xs.size();
+		endOfFile = size < blockSize;
+		if (endOfFile and not inFile.eof()) {
+			output << "error: wrong format" << endLine;
+			return;
+		}
+		positions.resize(size);
+		polygon.pointPositions(xs.data(), ys.data(), size, positions.data());
+		for (int i = 0; i < size; ++i) {
+			++counts[positions[i]];
+			if (writeAll) out << names[positions[i]] << '\n';
+		}
+	}
+	output << counts[Inside] << " " << counts[Boundary] << " " << counts[Outside] << endLine;
+}
+
+/** Writes the given names in a line, separated by spaces (the line is empty if there are no names). */
+void printNames(const vector<string>& names, Output& output) {
+	for (size_t i = 0; i < names.size(); ++i) {
+		if (i > 0) output << " ";
+		output << names[i];
+	}
+	output << endLine;
+}
+
+/** Prints the names of the polygons that contain the given point or have it on their boundary, lexicographically sorted. */
+void containingPoint(PolygonStore& store, CommandLine& args, Output& output) {
+	double x, y;
+	if (not (args >> x >> y)) {
+		output << "error: wrong type argument" << endLine;
+		return;
+	}
+	spatialIndex.update(store);
+	vector<string> names;
+	spatialIndex.containing(store, Point(x, y), names);
+	printNames(names, output);
+}
+
+/** Prints the names of the polygons that have some point in common with the window given by two opposite corners, lexicographically sorted. */
+void overlappingWindow(PolygonStore& store, CommandLine& args, Output& output) {
+	double x1, y1, x2, y2;
+	if (not (args >> x1 >> y1 >> x2 >> y2)) {
+		output << "error: wrong type argument" << endLine;
+		return;
+	}
+	spatialIndex.update(store);
+	vector<string> names;
+	spatialIndex.overlapping(store, min(x1, x2), max(x1, x2), min(y1, y2), max(y1, y2), names);
+	printNames(names, output);
+}
+
+/** Prints the names of the "k" polygons nearest to the given point, from the nearest one. The polygons that contain the point are at distance zero,
+	and the polygons at the same distance are sorted by name. */
+void nearestPolygons(PolygonStore& store, CommandLine& args, Output& output) {
+	double x, y, k;
+	if (not (args >> x >> y >> k) or k < 0 or k != int(k)) {
+		output << "error: wrong type argument" << endLine;
+		return;
+	}
+	spatialIndex.update(store);
+	vector<string> names;
+	spatialIndex.nearest(store, Point(x, y), int(k), names);
+	printNames(names, output);
+}
+
+/** Prints, for every command and operation that has been measured, the number of calls and the median, 99th percentile and maximum of its time
+	in microseconds, and for the operations, of the number of vertices of their input (and the percentage of them that they discard, if they filter it). With an argument, "on" and "off" enable and disable
+	the statistics, and "reset" empties them. */
+void printStats(PolygonStore& store, CommandLine& args, Output& output) {
+	imageQueue.waitAll();    // So that the statistics include the images drawn by the previous commands.
+	string option;
+	if (args >> option) {
+		if (option == "on") statsEnabled = true;
+		else if (option == "off") statsEnabled = false;
+		else if (option == "reset") {
+			for (Metric* m : allMetrics()) {
+				m->time.reset();
+				m->vertices.reset();
+				m->discarded.reset();
+			}
+		} else {
+			output << "error: wrong type argument" << endLine;
+			return;
+		}
+		output << "ok" << endLine;
+		return;
+	}
+	bool empty = true;
+	for (Metric* m : allMetrics()) {
+		const Histogram& time = m->time;
+		if (time.count() == 0) continue;
+		empty = false;
+		output << m->name << ": " << long(time.count()) << " calls, p50 " << time.percentile(0.5)/1000.0 << " us, p99 "
+		       << time.percentile(0.99)/1000.0 << " us, max " << time.max()/1000.0 << " us";
+		const Histogram& vertices = m->vertices;
+		if (vertices.count() > 0) {
+			output << ", vertices p50 " << long(vertices.percentile(0.5)) << ", p99 " << long(vertices.percentile(0.99))
+			       << ", max " << long(vertices.max());
+		}
+		const Histogram& discarded = m->discarded;
+		if (discarded.count() > 0 and vertices.sum() > 0) output << ", discarded " << 100.0*discarded.sum()/vertices.sum() << "%";
+		output << endLine;
+	}
+	if (empty) output << (statsOn() ? "no statistics" : "error: statistics are disabled") << endLine;
+}
+
+/** With an argument, "on" and "off" enable and disable the prefilter of the convex hull, which discards the points inside the polygon of the extreme 
+	points before sorting them. Without arguments, prints whether it is enabled. */
+void setPrefilter(PolygonStore& store, CommandLine& args, Output& output) {
+	string option;
+	if (not (args >> option)) {
+		output << (hullPrefilter() ? "on" : "off") << endLine;
+		return;
+	}
+	if (option == "on") setHullPrefilter(true);
+	else if (option == "off") setHullPrefilter(false);
+	else {
+		output << "error: wrong type argument" << endLine;
+		return;
+	}
+	output << "ok" << endLine;
+}
+
+/** Prints the bytes used by the store of polygons: by the coordinates of the vertices, by the characters of the identifiers, and by everything else
+	(the records, the hash table of the identifiers, and the space of the arena that is not used or is no longer used). */
+void printMemory(PolygonStore& store, CommandLine& args, Output& output) {
+	StoreMemory memory = store.memory();
+	output << "vertices " << long(memory.vertices) << " names " << long(memory.names) << " overhead " << long(memory.overhead) << endLine;
+}
+
+/** Saves the current polygons and colors, so that a rollback can go back to them. */
+void checkpointStore(PolygonStore& store, CommandLine& args, Output& output) {
+	store.checkpoint();
+	output << "ok" << endLine;
+}
+
+/** Puts back the polygons and colors saved by the last checkpoint, which is removed, and reports the polygons that change to the spatial index. */
+void rollbackStore(PolygonStore& store, CommandLine& args, Output& output) {
+	vector<Handle> restored;
+	if (not store.rollback(restored)) {
+		output << "error: no checkpoint" << endLine;
+		return;
+	}
+	for (Handle h : restored) spatialIndex.touch(h);
+	output << "ok" << endLine;
+}
+
+/** Removes the last checkpoint, keeping the current polygons and colors. */
+void commitStore(PolygonStore& store, CommandLine& args, Output& output) {
+	if (not store.commit()) {
+		output << "error: no checkpoint" << endLine;
+		return;
+	}
+	output << "ok" << endLine;
+}
+
+/** Replaces the journal by a snapshot of the polygons and colors, so that it is replayed faster. */
+void snapshotJournal(PolygonStore& store, CommandLine& args, Output& output) {
+	if (not journal.isOpen()) {
+		output << "error: no journal" << endLine;
+		return;
+	}
+	if (store.checkpoints() > 0) {
+		output << "error: pending checkpoint" << endLine;
+		return;
+	}
+	if (not journal.snapshot(store)) {
+		output << "error: unable to write file " << journal.name() << endLine;
+		return;
+	}
+	output << "ok" << endLine;
 }
 
 /** Creates a new polygon with the four vertices corresponding to the bounding box of the given polygons. */
-void boundingBox(map<string, ConvexPolygon>& polygons, istringstream& iss) {
+void boundingBox(PolygonStore& store, CommandLine& args, Output& output) {
 	string nameBox;
-	iss >> nameBox;
-	if (not isString(nameBox)) return;
-	vector<string> insiders;
+	args >> nameBox;
+	if (not isString(nameBox, output)) return;
+	vector<const ConvexPolygon*>& insiders = polygonBuffer();
 	string namePolygon;
-	while (iss >> namePolygon) {
-		if (undefinedIdentifier(polygons, namePolygon)) return;
-		insiders.push_back(namePolygon);
-	}
-	polygons[nameBox] = polygons[nameBox].boundingBox(polygons, insiders);
-	cout << "ok" << endl;
-}
-
-int main() {
-	cout.setf(ios::fixed);	
-	cout.precision(3);
-	string line;
-	map<string, ConvexPolygon> polygons;
-	map<string, vector<double>> colors;
-	while (getline(cin, line)) {
-		istringstream iss(line);
-        string command;
-        iss >> command;
-        if (command == "#") cout << "#" << endl;  /** For comments */ 
-        else if (command == "polygon") {
-        	createNewPolygon(polygons, colors, iss);
-  			cout << "ok" << endl;
+	Handle h;
+	while (args >> namePolygon) {
+		if (undefinedIdentifier(store, namePolygon, h, output)) return;
+		insiders.push_back(&store.polygon(h));
+	}
+	h = store.intern(nameBox);
+	store.setPolygon(h, store.polygon(h).boundingBox(insiders));
+	output << "ok" << endLine;
+}
+
+/** Writes a hash sign: lines starting with "#" are comments. */
+void comment(PolygonStore& store, CommandLine& args, Output& output) {
+	output << "#" << endLine;
+}
+
+/** Runs the polygon command. An "ok" is written even when the name is wrong. */
+void newPolygon(PolygonStore& store, CommandLine& args, Output& output) {
+	createNewPolygon(store, args, output);
+	output << "ok" << endLine;
+}
+
+/** Type of the functions that run the commands. */
+typedef void (*Handler)(PolygonStore&, CommandLine&, Output&);
+
+/** Polygons and files that a command uses, according to its arguments (needed to run the commands of a batch in parallel). */
+enum Arguments {
+	NoPolygons,           // It does not use any polygon.
+	ReadPolygons,         // All its arguments are polygons that it reads.
+	WritePolygon,         // Writes the polygon given first (the other arguments are not polygons).
+	WriteFirstPolygon,    // Writes the polygon given first and reads the other ones.
+	WriteFile,            // Writes the file given first and reads the polygons given next.
+	WritePolygonReadFile, // Writes the polygon given first and reads the file given next.
+	ClassifyArguments,    // Reads a polygon and a file, and writes the file given last.
+	AllPolygons,          // Reads all the polygons.
+	AnyPolygon            // May change any polygon or use any file.
+};
+
+/** Name of every command, the function that runs it and the kind of its arguments. */
+struct Command {
+	const char* name;
+	Handler handler;
+	Arguments arguments;
+};
+
+const Command commands[] = {
+	{"#", comment, NoPolygons},
+	{"polygon", newPolygon, WritePolygon},
+	{"extend", extendPolygon, WritePolygon},
+	{"print", printVertices, ReadPolygons},
+	{"area", getArea, ReadPolygons},
+	{"perimeter", getPerimeter, ReadPolygons},
+	{"vertices", getVertices, ReadPolygons},
+	{"centroid", getCentroid, ReadPolygons},
+	{"list", getList, AllPolygons},
+	{"save", saveFile, WriteFile},
+	{"load", loadFile, AnyPolygon},
+	{"setcol", setCol, WritePolygon},
+	{"streamhull", streamHullFile, WritePolygonReadFile},
+	{"draw", drawPolygon, WriteFile},
+	{"fill", fillPolygon, WriteFile},
+	{"tiles", drawTiles, WriteFile},
+	{"sync", syncImages, AllPolygons},           // Exclusive, so that it waits for the images of all the previous commands.
+	{"intersection", getIntersection, WriteFirstPolygon},
+	{"union", getUnion, WriteFirstPolygon},
+	{"inside", inside, ReadPolygons},
+	{"bbox", boundingBox, WriteFirstPolygon},
+	{"classify", classifyPoints, ClassifyArguments},
+	{"containing", containingPoint, AllPolygons},
+	{"overlapping", overlappingWindow, AllPolygons},
+	{"nearest", nearestPolygons, AllPolygons},
+	{"stats", printStats, AllPolygons},          // Exclusive, so that it sees the statistics of all the previous commands.
+	{"memstats", printMemory, AllPolygons},
+	{"prefilter", setPrefilter, AllPolygons},     // Exclusive, so that the statistics of every hull do not depend on the order of the commands.
+	{"checkpoint", checkpointStore, AllPolygons}, // Exclusive, like rollback and commit, since they save or change any polygon.
+	{"rollback", rollbackStore, AllPolygons},     // Reports the polygons that it changes to the spatial index itself.
+	{"commit", commitStore, AllPolygons},
+	{"snapshot", snapshotJournal, AllPolygons},
+};
+
+/* The CommandTable class finds the command with a given name with a single probe: every command has its own slot in a hash table,
+whose size is doubled when it is built until no two commands fall in the same slot (a perfect hash). */
+class CommandTable {
+
+public:
+	/** Constructor. */
+	CommandTable() {
+		int count = sizeof(commands)/sizeof(commands[0]);
+		bool perfect = false;
+		for (int size = 32; not perfect; size *= 2) {
+			slots.assign(size, nullptr);
+			perfect = true;
+			for (int i = 0; i < count and perfect; ++i) {
+				const Command*& slot = slots[hash(commands[i].name, strlen(commands[i].name)) & (size - 1)];
+				if (slot != nullptr) perfect = false;
+				else slot = &commands[i];
+			}
 		}
-		else if (command == "print") printVertices(polygons, iss);		
-		else if (command == "area") getArea(polygons, iss);
-		else if (command == "perimeter") getPerimeter(polygons, iss);	
-		else if (command == "vertices") getVertices(polygons, iss);
-		else if (command == "centroid") getCentroid(polygons, iss);
-		else if (command == "list") getList(polygons);
-		else if (command == "save") saveFile(polygons, iss);
-		else if (command == "load") loadFile(polygons, colors, iss);
-		else if (command == "setcol") setCol(polygons, colors, iss);		
-		else if (command == "draw") drawPolygon(polygons, colors, iss);		
-		else if (command == "intersection") getIntersection(polygons, iss);
-		else if (command == "union") getUnion(polygons, iss);
-		else if (command == "inside") inside(polygons, iss);	
-		else if (command == "bbox") boundingBox(polygons, iss);
-		else cout << "error: unrecognized command" << endl;
- 	}
+		for (int i = 0; i < count; ++i) metrics.push_back(&metric(commands[i].name));
+	}
+
+	/** Returns the command whose name has "size" characters starting at "name", or "nullptr" if there is none. */
+	const Command* find(const char* name, size_t size) const {
+		const Command* command = slots[hash(name, size) & (slots.size() - 1)];
+		if (command == nullptr or strlen(command->name) != size or memcmp(command->name, name, size) != 0) return nullptr;
+		return command;
+	}
+
+	/** Returns the statistics of a command of the table. */
+	Metric& metricOf(const Command* command) const {
+		return *metrics[command - commands];
+	}
+
+private:
+
+	vector<const Command*> slots;
+	vector<Metric*> metrics;
+
+	/** FNV-1a hash of the characters. */
+	static unsigned hash(const char* name, size_t size) {
+		unsigned h = 2166136261u;
+		for (size_t i = 0; i < size; ++i) h = (h ^ (unsigned char)name[i])*16777619u;
+		return h;
+	}
+};
+
+/** File names are told apart from polygon identifiers, which cannot contain an end of line character, by this prefix. */
+const string filePrefix = "\n";
+
+/** Stores in "access" the polygons and files used by a command with the given kind of arguments, which are in [p, end).
+	The handlers use the empty identifier when a command has less than two arguments (and the polygon command may create it), so then it is also read. */
+void getAccess(Arguments arguments, const char* p, const char* end, BatchAccess& access) {
+	if (arguments == NoPolygons) return;
+	if (arguments == AllPolygons or arguments == AnyPolygon) {
+		access.exclusive = true;
+		return;
+	}
+	vector<string> words;
+	const char* word;
+	size_t size;
+	for (parseWord(p, end, word, size); size > 0; parseWord(p, end, word, size)) words.push_back(string(word, size));
+	if (words.size() < 2) access.reads.push_back("");
+	if (words.empty()) words.push_back("");
+	int first = 0;
+	if (arguments == WritePolygon or arguments == WriteFirstPolygon) {
+		access.writes.push_back(words[0]);
+		if (arguments == WritePolygon) return;
+		first = 1;
+	} else if (arguments == WriteFile) {
+		access.writes.push_back(filePrefix + words[0]);
+		first = 1;
+	} else if (arguments == WritePolygonReadFile) {
+		access.writes.push_back(words[0]);
+		if (words.size() > 1) access.reads.push_back(filePrefix + words[1]);
+		return;
+	} else if (arguments == ClassifyArguments) {
+		access.reads.push_back(words[0]);
+		if (words.size() > 1) access.reads.push_back(filePrefix + words[1]);
+		if (words.size() > 2) access.writes.push_back(filePrefix + words[2]);
+		return;
+	}
+	for (size_t i = first; i < words.size(); ++i) access.reads.push_back(words[i]);
+}
+
+/** Returns "true" if the identifiers written by a command (the resources of "access" that are not files) are interned. */
+bool interned(const PolygonStore& store, const BatchAccess& access) {
+	for (const string& name : access.writes) {
+		if (name.compare(0, filePrefix.size(), filePrefix) != 0 and store.find(name) == noHandle) return false;
+	}
+	return true;
+}
+
+/** Interns the identifiers written by a command. The ones that it only reads are looked up by the handlers without interning them
+	(an identifier that is not interned is not defined either), so the identifiers that are only read, like misspelled ones, never get a handle. */
+void internIdentifiers(PolygonStore& store, const BatchAccess& access) {
+	for (const string& name : access.writes) if (name.compare(0, filePrefix.size(), filePrefix) != 0) store.intern(name);
 }
 
+/** Reports to the spatial index the polygons that may have been changed by a command with the given kind of arguments, which are in [p, end). */
+void reportChanges(const PolygonStore& store, Arguments arguments, const char* p, const char* end) {
+	if (arguments == AnyPolygon) spatialIndex.touchAll();
+	else if (arguments == WritePolygon or arguments == WriteFirstPolygon or arguments == WritePolygonReadFile) {
+		const char* word;
+		size_t size;
+		parseWord(p, end, word, size);
+		Handle h = store.find(string(word, size));
+		if (h != noHandle) spatialIndex.touch(h);
+	}
+}
+
+/** Before running a command with the given kind of arguments, which are in [p, end), waits for the images being drawn in the files that it uses.
+	The commands that may use any file wait for all of them. */
+void waitForImages(Arguments arguments, const char* p, const char* end) {
+	if (imageQueue.idle()) return;
+	if (arguments == AnyPolygon) imageQueue.waitAll();
+	else if (arguments == WriteFile or arguments == WritePolygonReadFile or arguments == ClassifyArguments) {
+		BatchAccess access;
+		getAccess(arguments, p, end, access);
+		for (const vector<string>* names : {&access.reads, &access.writes}) {
+			for (const string& name : *names) {
+				if (name.compare(0, filePrefix.size(), filePrefix) == 0) imageQueue.waitFile(name.substr(filePrefix.size()));
+			}
+		}
+	}
+}
+
+/** Runs the commands of a script (the standard input) in parallel, as a batch, and writes their answers in the same order as the commands.
+	The results are the same as when the commands are run one after another. */
+void runScript(PolygonStore& store, const CommandTable& table, Output& output) {
+	vector<char> text;
+	vector<size_t> starts = {0};
+	LineReader reader(0);
+	const char* begin;
+	const char* end;
+	while (reader.next(begin, end)) {
+		text.insert(text.end(), begin, end);
+		starts.push_back(text.size());
+	}
+	int size = starts.size() - 1;
+
+	vector<const Command*> lineCommands(size);
+	vector<const char*> argsBegin(size);
+	vector<BatchAccess> accesses(size);
+	for (int i = 0; i < size; ++i) {
+		const char* p = text.data() + starts[i];
+		end = text.data() + starts[i+1];
+		const char* command;
+		size_t length;
+		parseWord(p, end, command, length);
+		lineCommands[i] = table.find(command, length);
+		argsBegin[i] = p;
+		if (lineCommands[i] != nullptr) getAccess(lineCommands[i]->arguments, p, end, accesses[i]);
+	}
+
+	/* The identifiers written by the commands are interned before running them, so the other commands only look up their handles
+	and change their records, which never move (only the exclusive ones, like load, may add identifiers or compact the store).
+	The changes are reported to the spatial index holding a lock. */
+	for (const BatchAccess& access : accesses) internIdentifiers(store, access);
+	vector<unique_ptr<Output>> answers(size);
+	for (int i = 0; i < size; ++i) answers[i].reset(new Output());
+	mutex lock;
+	runBatch(accesses, hardwareThreads(), [&](int i) {
+		Output& answer = *answers[i];
+		if (lineCommands[i] == nullptr) {
+			answer << "error: unrecognized command" << endLine;
+			return;
+		}
+		Timer timer(table.metricOf(lineCommands[i]));
+		currentCommand = i;
+		waitForImages(lineCommands[i]->arguments, argsBegin[i], text.data() + starts[i+1]);
+		CommandLine args(argsBegin[i], text.data() + starts[i+1]);
+		if (accesses[i].exclusive) {
+			store.compactIfNeeded();
+			lineCommands[i]->handler(store, args, answer);
+			reportChanges(store, lineCommands[i]->arguments, argsBegin[i], text.data() + starts[i+1]);
+			return;
+		}
+		lineCommands[i]->handler(store, args, answer);
+		lock_guard<mutex> guard(lock);
+		reportChanges(store, lineCommands[i]->arguments, argsBegin[i], text.data() + starts[i+1]);
+	}, [&](int i) {
+		output.append(*answers[i]);
+		answers[i].reset();
+	});
+}
+
+/** Writes the records of the journal that are pending (after replacing it by a snapshot, if it has grown enough), and writes an error line
+	if they cannot be written. */
+void syncJournal(const PolygonStore& store, Output& output) {
+	if (not journal.isOpen()) return;
+	bool written = journal.snapshotIfNeeded(store);
+	if (not journal.flush() or not written) output << "error: unable to write file " << journal.name() << endLine;
+}
+
+/** Runs a command of a session of the server, whose arguments are in [p, end), holding the locks that it needs.
+	The identifiers that it writes are interned first, holding the whole store, since interning may move the records and the hash table.
+	Interned identifiers are never removed, so the command can then run holding only its own resources.
+	It waits for the images of its files once it holds them, so no other session can start drawing one of them in between. */
+void runSessionCommand(PolygonStore& store, const Command* command, const char* p, const char* end, Output& output) {
+	BatchAccess access;
+	getAccess(command->arguments, p, end, access);
+	CommandLine args(p, end);
+	if (access.exclusive) {
+		storeLock.lock();
+		waitForImages(command->arguments, p, end);
+		store.compactIfNeeded();
+		command->handler(store, args, output);
+		reportChanges(store, command->arguments, p, end);
+		storeLock.unlock();
+		return;
+	}
+	storeLock.lockShared();
+	if (not interned(store, access)) {
+		storeLock.unlockShared();
+		storeLock.lock();
+		internIdentifiers(store, access);
+		storeLock.unlock();
+		storeLock.lockShared();
+	}
+	vector<pair<int, bool>> held;
+	resourceLocks.lock(access, held);
+	waitForImages(command->arguments, p, end);
+	command->handler(store, args, output);
+	{
+		lock_guard<mutex> guard(indexLock);
+		reportChanges(store, command->arguments, p, end);
+	}
+	resourceLocks.unlock(held);
+	bool compact = store.needsCompaction();
+	storeLock.unlockShared();
+	if (compact) {
+		storeLock.lock();
+		store.compactIfNeeded();
+		storeLock.unlock();
+	}
+}
+
+/** Like "syncJournal", for a session of the server. The snapshot reads the whole store, so it is written holding it as the writer,
+	while the records are written and synchronized without holding it: the records of the sessions that wait for more commands at the same time
+	are synchronized together. */
+void syncSessionJournal(const PolygonStore& store, Output& output) {
+	if (not journal.isOpen()) return;
+	storeLock.lockShared();
+	bool needed = journal.needsSnapshot(store);
+	storeLock.unlockShared();
+	bool written = true;
+	if (needed) {
+		storeLock.lock();
+		written = journal.snapshotIfNeeded(store);
+		storeLock.unlock();
+	}
+	if (not journal.flush() or not written) output << "error: unable to write file " << journal.name() << endLine;
+}
+
+/** Runs the commands that a client of the server sends through the socket "fd", and sends back their answers, as in the normal mode:
+	the answers are sent (once the changes are in the journal) when the session waits for more commands, and at the end the images of the session
+	that could not be written are reported. */
+void runSession(PolygonStore& store, const CommandTable& table, int fd, long number) {
+	currentSession = number;
+	Output output(fd);
+	LineReader reader(fd, [&] {
+		syncSessionJournal(store, output);
+		output.flush();
+	});
+	const char* begin;
+	const char* end;
+	for (long line = 0; reader.next(begin, end); ++line) {
+		const char* p = begin;
+		const char* name;
+		size_t size;
+		parseWord(p, end, name, size);
+		const Command* command = table.find(name, size);
+		if (command == nullptr) output << "error: unrecognized command" << endLine;
+		else {
+			Timer timer(table.metricOf(command));
+			currentCommand = number*sessionCommands + line;
+			runSessionCommand(store, command, p, end, output);
+		}
+	}
+	syncSessionJournal(store, output);
+	reportImages(output);
+}
+
+/** Runs the server mode: every client that connects to the socket "nameSocket" gets a session, until the calculator gets SIGINT or SIGTERM.
+	Then it waits for the commands that are running and for the images, writes the journal and removes the socket, and ends
+	without waiting for the sessions whose clients are still connected. */
+int serve(PolygonStore& store, const CommandTable& table, const string& nameSocket) {
+	int listener = listenSocket(nameSocket);
+	if (listener < 0) {
+		cerr << "error: unable to open socket " << nameSocket << endl;
+		return 1;
+	}
+	acceptSessions(listener, [&](int fd, long number) { runSession(store, table, fd, number); });
+	storeLock.lock();
+	journal.flush();
+	imageQueue.waitAll();
+	unlink(nameSocket.c_str());
+	_exit(0);
+}
+
+/** Runs the commands read from the standard input. With the "--batch" option, the whole input is read first and the commands are run in parallel.
+	With the "--journal" option, the polygons are first restored from the given journal, and their changes are recorded in it.
+	The changes are on disk once the calculator waits for more input (or, in batch mode, at the end).
+	With the "--serve" option, the commands are received from the clients of a Unix domain socket instead, and with the "--connect" option,
+	the calculator is one of these clients: it sends the standard input to the server and writes its answers. */
+int main(int argc, char* argv[]) {
+	Output output(1);
+	PolygonStore store;
+	CommandTable table;
+	initStats();
+	bool batch = false;
+	string nameJournal, nameSocket, nameServer;
+	bool wrong = false;
+	for (int i = 1; i < argc and not wrong; ++i) {
+		if (strcmp(argv[i], "--batch") == 0) batch = true;
+		else if (strcmp(argv[i], "--journal") == 0 and i + 1 < argc) nameJournal = argv[++i];
+		else if (strcmp(argv[i], "--serve") == 0 and i + 1 < argc) nameSocket = argv[++i];
+		else if (strcmp(argv[i], "--connect") == 0 and i + 1 < argc and argc == 3) nameServer = argv[++i];
+		else wrong = true;
+	}
+	if (wrong or (batch and not nameSocket.empty())) {
+		cerr << "usage: " << argv[0] << " [--batch | --serve socket] [--journal file] | --connect socket" << endl;
+		return 1;
+	}
+	if (not nameServer.empty()) {
+		int fd = connectSocket(nameServer);
+		if (fd < 0) {
+			cerr << "error: unable to open socket " << nameServer << endl;
+			return 1;
+		}
+		bool forwarded = forward(fd, 0, 1);
+		close(fd);
+		return forwarded ? 0 : 1;
+	}
+	if (not nameJournal.empty()) {
+		if (not journal.open(nameJournal, store)) {
+			cerr << "error: unable to open file " << nameJournal << endl;
+			return 1;
+		}
+		store.setJournal(&journal);
+		store.compactIfNeeded();
+		spatialIndex.touchAll();
+	}
+	if (not nameSocket.empty()) return serve(store, table, nameSocket);
+	if (batch) {
+		runScript(store, table, output);
+		syncJournal(store, output);
+		reportImages(output);
+		return 0;
+	}
+	LineReader reader(0, [&] {
+		syncJournal(store, output);
+		output.flush();
+	});
+	const char* begin;
+	const char* end;
+	for (long line = 0; reader.next(begin, end); ++line) {
+		const char* p = begin;
+		const char* name;
+		size_t size;
+		parseWord(p, end, name, size);
+		const Command* command = table.find(name, size);
+		if (command == nullptr) output << "error: unrecognized command" << endLine;
+		else {
+			Timer timer(table.metricOf(command));
+			currentCommand = line;
+			waitForImages(command->arguments, p, end);
+			CommandLine args(p, end);
+			command->handler(store, args, output);
+			reportChanges(store, command->arguments, p, end);
+			store.compactIfNeeded();
+		}
+ 	}
+	syncJournal(store, output);
+	reportImages(output);
+}
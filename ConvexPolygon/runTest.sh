@@ -1,6 +1,6 @@
 #/bin/bash
 
-echo "executing test 1 out of 3"
+echo "executing test 1 out of 22"
 
 ./main.exe < input/test1.txt > output1.txt
 
@@ -12,7 +12,7 @@ else
 	echo "test 1 succeeded"
 fi
 
-echo "executing test 2 out of 3"
+echo "executing test 2 out of 22"
 
 ./main.exe < input/test2.txt > output2.txt
 
@@ -24,7 +24,7 @@ else
 	echo "test 2 succeeded"
 fi
 
-echo "executing test 3 out of 3"
+echo "executing test 3 out of 22"
 
 ./main.exe < input/test3.txt > output3.txt
 
@@ -35,3 +35,266 @@ if [ "$?" != "0" ] ; then
 else 
 	echo "test 3 succeeded"
 fi
+
+echo "executing test 4 out of 22"
+
+./main.exe < input/test4.txt > output4.txt
+
+diff output4.txt output/expectedOutput4.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 4 failed"	
+else 
+	echo "test 4 succeeded"
+fi
+
+echo "executing test 5 out of 22"
+
+./main.exe < input/test5.txt > output5.txt
+cat classified.txt >> output5.txt
+rm -f classified.txt
+
+diff output5.txt output/expectedOutput5.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 5 failed"	
+else 
+	echo "test 5 succeeded"
+fi
+
+echo "executing test 6 out of 22"
+
+./main.exe < input/test6.txt > output6.txt
+
+diff output6.txt output/expectedOutput6.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 6 failed"	
+else 
+	echo "test 6 succeeded"
+fi
+
+echo "executing test 7 out of 22"
+
+./main.exe --batch < input/test3.txt > output7.txt
+
+diff output7.txt output/expectedOutput3.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 7 failed"	
+else 
+	echo "test 7 succeeded"
+fi
+
+echo "executing test 8 out of 22"
+
+./main.exe < input/test8.txt > output8.txt
+
+diff output8.txt output/expectedOutput8.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 8 failed"	
+else 
+	echo "test 8 succeeded"
+fi
+
+echo "executing test 9 out of 22"
+
+./main.exe < input/test9.txt > output9.txt
+
+diff output9.txt output/expectedOutput9.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 9 failed"	
+else 
+	echo "test 9 succeeded"
+fi
+
+echo "executing test 10 out of 22"
+
+./main.exe < input/test10.txt > output10.txt
+
+diff output10.txt output/expectedOutput10.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 10 failed"	
+else 
+	echo "test 10 succeeded"
+fi
+
+echo "executing test 11 out of 22"
+
+./main.exe < input/test11.txt > output11.txt
+rm -f image11.png
+
+diff output11.txt output/expectedOutput11.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 11 failed"	
+else 
+	echo "test 11 succeeded"
+fi
+
+echo "executing test 12 out of 22"
+
+./main.exe < input/test12.txt > output12.txt
+
+diff output12.txt output/expectedOutput12.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 12 failed"	
+else 
+	echo "test 12 succeeded"
+fi
+
+echo "executing test 13 out of 22"
+
+rm -f test.journal
+./main.exe --journal test.journal < input/test13.txt > output13.txt
+printf 'torn record' >> test.journal
+./main.exe --journal test.journal < input/test13b.txt >> output13.txt
+rm -f test.journal
+
+diff output13.txt output/expectedOutput13.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 13 failed"	
+else 
+	echo "test 13 succeeded"
+fi
+
+echo "executing test 14 out of 22"
+
+rm -f test.socket
+./main.exe --serve test.socket &
+server=$!
+for i in $(seq 50); do
+	if [ -S test.socket ] ; then break ; fi
+	sleep 0.1
+done
+./main.exe --connect test.socket < input/test14.txt > output14.txt
+./main.exe --connect test.socket < input/test14b.txt >> output14.txt
+kill $server
+wait $server
+if [ -e test.socket ] ; then echo "socket not removed" >> output14.txt ; fi
+
+diff output14.txt output/expectedOutput14.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 14 failed"	
+else 
+	echo "test 14 succeeded"
+fi
+
+echo "executing test 15 out of 22"
+
+./testKernels.exe > output15.txt
+
+diff output15.txt output/expectedOutput15.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 15 failed"	
+else 
+	echo "test 15 succeeded"
+fi
+
+echo "executing test 16 out of 22"
+
+./main.exe < input/test16.txt > output16.txt
+for f in a b c d ; do cmp -s image16$f.png output/expectedImage16$f.png || echo "image16$f.png differs" >> output16.txt ; done
+rm -f image16*.png
+
+diff output16.txt output/expectedOutput16.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 16 failed"	
+else 
+	echo "test 16 succeeded"
+fi
+
+echo "executing test 17 out of 22"
+
+./main.exe --batch < input/test17.txt > memory17.txt
+./main.exe --batch < input/test17b.txt > memory17b.txt
+sed 's/ overhead [0-9]*//' memory17.txt > output17.txt
+grep vertices memory17b.txt | diff - <(grep vertices memory17.txt) >> output17.txt
+rm -f memory17.txt memory17b.txt
+
+diff output17.txt output/expectedOutput17.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 17 failed"	
+else 
+	echo "test 17 succeeded"
+fi
+
+echo "executing test 18 out of 22"
+
+./main.exe < input/test18.txt > output18.txt
+
+diff output18.txt output/expectedOutput18.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 18 failed"	
+else 
+	echo "test 18 succeeded"
+fi
+
+echo "executing test 19 out of 22"
+
+./main.exe < input/test19.txt > output19.txt
+head -c 100 store19.cpb > truncated19.cpb
+head -c 300 store19.cpb > truncated19b.cpb
+./main.exe < input/test19b.txt >> output19.txt
+rm -f store19.cpb truncated19.cpb truncated19b.cpb
+
+diff output19.txt output/expectedOutput19.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 19 failed"	
+else 
+	echo "test 19 succeeded"
+fi
+
+echo "executing test 20 out of 22"
+
+./main.exe < input/test20.txt > output20.txt
+find tiles20 -type f | sort >> output20.txt
+./main.exe < input/test20b.txt >> output20.txt
+find tiles20 -type f | sort >> output20.txt
+rm -rf tiles20
+
+diff output20.txt output/expectedOutput20.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 20 failed"	
+else 
+	echo "test 20 succeeded"
+fi
+
+echo "executing test 21 out of 22"
+
+./main.exe < input/test21.txt > output21.txt
+sed 's/prefilter off/prefilter on/' input/test21.txt | ./main.exe > output21b.txt
+diff output21b.txt output21.txt >> output21.txt
+rm -f output21b.txt
+
+diff output21.txt output/expectedOutput21.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 21 failed"	
+else 
+	echo "test 21 succeeded"
+fi
+
+echo "executing test 22 out of 22"
+
+./main.exe < input/test22.txt | sed 's/[0-9.]* us/t us/g' > output22.txt
+
+diff output22.txt output/expectedOutput22.txt
+
+if [ "$?" != "0" ] ; then 
+	echo "test 22 failed"	
+else 
+	echo "test 22 succeeded"
+fi
@@ -0,0 +1,95 @@
+#include "Kernels.hh"
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+using namespace std;
+
+/* Test of the kernel levels: every level supported by the processor must give exactly the same bits as the scalar one, for polygons of every
+size up to a few vectors and some big ones, with coordinates of very different magnitudes. The levels that the processor does not support
+run the best supported one instead, so the output is the same on every processor. It prints a line per level with the number of polygons
+that give the same results, and returns "1" if any of them differs. */
+
+/* Returns "true" if both sums have the same bits. */
+static bool sameSums(const PolygonSums& a, const PolygonSums& b) {
+	double va[8] = {a.area, a.perimeter, a.cX, a.cY, a.xmin, a.xmax, a.ymin, a.ymax};
+	double vb[8] = {b.area, b.perimeter, b.cX, b.cY, b.xmin, b.xmax, b.ymin, b.ymax};
+	return memcmp(va, vb, sizeof(va)) == 0;
+}
+
+int main() {
+	const char* names[] = {"scalar", "sse2", "avx2"};
+	KernelLevel best = bestKernelLevel();
+	mt19937 random(2018);
+	vector<vector<double>> xs, ys;
+	for (int size = 0; size < 40; ++size) {
+		for (double scale : {1e-3, 1.0, 1e3, 1e9}) {
+			uniform_real_distribution<double> coordinate(-scale, scale);
+			for (int copy = 0; copy < 10; ++copy) {
+				vector<double> x(size), y(size);
+				for (int i = 0; i < size; ++i) {
+					x[i] = coordinate(random);
+					y[i] = coordinate(random);
+				}
+				xs.push_back(x);
+				ys.push_back(y);
+			}
+		}
+	}
+	for (int size : {1000, 10007, 100003}) {
+		vector<double> x(size), y(size);
+		for (int i = 0; i < size; ++i) {
+			double angle = -2*M_PI*i/size;    // Clockwise, as the vertices of a ConvexPolygon.
+			x[i] = 100*cos(angle) + 0.1;
+			y[i] = 100*sin(angle) - 0.3;
+		}
+		xs.push_back(x);
+		ys.push_back(y);
+	}
+
+	int polygons = xs.size();
+	vector<PolygonSums> expected(polygons);
+	vector<ExtremePoints> extremes(polygons);
+	setKernelLevel(ScalarKernel);
+	for (int p = 0; p < polygons; ++p) polygonSums(xs[p].data(), ys[p].data(), xs[p].size(), expected[p]);
+
+	bool ok = true;
+	for (int level = SSEKernel; level <= AVX2Kernel; ++level) {
+		setKernelLevel(KernelLevel(level));
+		int same = 0;
+		for (int p = 0; p < polygons; ++p) {
+			PolygonSums sums;
+			polygonSums(xs[p].data(), ys[p].data(), xs[p].size(), sums);
+			if (sameSums(sums, expected[p])) ++same;
+		}
+		cout << names[level] << ": " << same << " of " << polygons << " polygons with the same sums as scalar" << endl;
+		ok = ok and same == polygons;
+	}
+
+	/* The extreme points of the vertices of the same polygons, interleaved. */
+	for (int level = ScalarKernel; level <= AVX2Kernel; ++level) {
+		setKernelLevel(KernelLevel(level));
+		int same = 0, count = 0;
+		for (int p = 0; p < polygons; ++p) {
+			int size = xs[p].size();
+			if (size == 0) continue;
+			vector<double> xy(2*size);
+			for (int i = 0; i < size; ++i) {
+				xy[2*i] = xs[p][i];
+				xy[2*i + 1] = ys[p][i];
+			}
+			ExtremePoints found;
+			extremePoints(xy.data(), size, found);
+			if (level == ScalarKernel) extremes[p] = found;
+			if (equal(found.position, found.position + 8, extremes[p].position)) ++same;
+			++count;
+		}
+		if (level == ScalarKernel) continue;
+		cout << names[level] << ": " << same << " of " << count << " point sets with the same extreme points as scalar" << endl;
+		ok = ok and same == count;
+	}
+	setKernelLevel(best);
+	return ok ? 0 : 1;
+}